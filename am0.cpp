@@ -1,7 +1,10 @@
 #include <iostream>
 #include <fstream>
 #include <map>
+#include <memory>
+#include <sstream>
 #include "am0_interpreter.hpp"
+#include "perf_counters.hpp"
 #define __PROG_NAME__ "am0"
 
 using namespace am0_interpreter;
@@ -11,6 +14,19 @@ int main(int argc, char** argv) {
 	bool logging = false;
 	bool file = false;
 	bool state = false;
+	bool perf = false;
+	bool perf_json = false;
+	bool streaming = false;
+	bool debugging = false;
+	bool publish = false;
+	bool analyzing = false;
+	bool detecting = false;
+	bool tiering = false;
+	string prog_name = "stdin";
+	string record_file, replay_file, residual_file;
+	vector<int> known;
+	unsigned long long skip_steps = 0;
+	unsigned int sample_interval = 0;
 	//map parameters to options
 	map<string,function<void()>> options = {
 		//enable the state logging of the machine
@@ -18,23 +34,93 @@ int main(int argc, char** argv) {
 		{"--logging", ([&] () {logging= true;})},
 		//enable parsing of a inital state
 		{"-i", ([&] () {state= true;})},
-		{"--init", ([&] () {state= true;})}
+		{"--init", ([&] () {state= true;})},
+		//enable hardware performance counters for the parse and execute phase
+		{"--perf-counters", ([&] () {perf= true;})},
+		{"--perf-json", ([&] () {perf= perf_json= true;})},
+		//enable running the machine while the code is still being parsed
+		{"-s", ([&] () {streaming= true;})},
+		{"--streaming", ([&] () {streaming= true;})},
+		//run the machine under the interactive debugger
+		{"-d", ([&] () {debugging= true;})},
+		{"--debug", ([&] () {debugging= true;})},
+		//publish statistics in shared memory for amstat
+		{"--stats", ([&] () {publish= true;})},
+		//stop the program if it loops forever
+		{"--detect-loops", ([&] () {detecting= true;})},
+		//run hot loops from compiled code
+		{"--tiered", ([&] () {tiering= true;})},
+		//estimate the costs of the program instead of running it
+		{"--analyze", ([&] () {analyzing= true;})}
+	};
+	//map parameters to options taking a value
+	map<string,function<bool(const string&)>> value_options = {
+		//record all read values into a log file
+		{"--record", ([&] (const string& v) {record_file= v; return true;})},
+		//replay the read values from a log file
+		{"--replay", ([&] (const string& v) {replay_file= v; return true;})},
+		//write a residual program specialized for known input values
+		{"--specialize", ([&] (const string& v) {residual_file= v; return true;})},
+		//input values known for specializing, seperated by a comma
+		{"--known", ([&] (const string& v) {
+			istringstream ls {v};
+			int value;
+			while (ls >> value) {
+				known.push_back(value);
+				if (ls.peek() == ',') ls.ignore();
+			}
+			return ls.eof();})},
+		//sample the machine every given microseconds of CPU time
+		{"--sample", ([&] (const string& v) {
+			if (v == "" || v.find_first_not_of("0123456789") != string::npos || v.size() > 9) return false;
+			sample_interval= stoul(v);
+			return sample_interval > 0;})},
+		//run without output up to a step before running normally
+		{"--fast-forward", ([&] (const string& v) {
+			if (v == "" || v.find_first_not_of("0123456789") != string::npos || v.size() > 19) return false;
+			skip_steps= stoull(v);
+			return true;})}
 	};
 	if (argc == 2 && (string {"--help"} == argv[1])) {
 		cout << "Call: am0 [OPTIONS] [INPUT-FILE]\nInterprets the INPUT-FILE as AM0-code.\n" <<
 			"If no INPUT-FILE is given, user input will be interpreted.\n\n" <<
 			"Options:\n" <<
 			"  -l, --logging\t\tEnable AM0 state logging\n" <<
-			"  -i, --init\t\tLet AM0 use a initial state\n\n" <<
+			"  -i, --init\t\tLet AM0 use a initial state\n" <<
+			"  -s, --streaming\tStart running while the code is still being parsed\n" <<
+			"  -d, --debug\t\tRun AM0 under the interactive debugger\n" <<
+			"  --record FILE\t\tRecord all input values into FILE\n" <<
+			"  --replay FILE\t\tRead all input values from a FILE recorded before\n" <<
+			"  --fast-forward N\tRun without any output up to step N first\n" <<
+			"  --stats\t\tPublish statistics while running, see amstat\n" <<
+			"  --detect-loops\tStop the program if its state repeats without reading a value\n" <<
+			"  --tiered\t\tCompile loops once they are hot and run them from the compiled code\n" <<
+			"  --sample US\t\tSample every US microseconds of CPU time and report hot lines\n" <<
+			"  --specialize FILE\tWrite the program specialized for the known input values to FILE\n" <<
+			"  --known V1,V2,..\tInput values known for specializing\n" <<
+			"  --analyze\t\tEstimate instruction and stack bounds without running\n" <<
+			"  --perf-counters\tReport performance counters of parsing and execution\n" <<
+			"  --perf-json\t\tReport performance counters as JSON\n\n" <<
 			"End input of AM0-code with Ctrl+D\n";
 		return 1;
 	}
 	am0 prog;
+	unique_ptr<perf_counters::counter_group> counters;
+	vector<perf_counters::sample> samples;
+	//measure a phase if performance counters are enabled
+	auto perf_start = [&] () {
+		if (!perf) return;
+		if (!counters) counters.reset(new perf_counters::counter_group);
+		counters->start();
+	};
+	auto perf_stop = [&] (const string& phase) { if (perf) samples.push_back(counters->stop(phase)); };
+	ifstream fs;
 	enum {FILE_T = true};
 	for (int i = 1; i < argc; ++i) {
 		if (argv[i][0] == '-') {
 			//apply options
 			if (options.count(argv[i])) options[argv[i]]();
+			else if (value_options.count(argv[i]) && i + 1 < argc && value_options[argv[i]](argv[i + 1])) ++i;
 			else {
 				cerr << __PROG_NAME__ << ": Invalid option '" << argv[i] << "'" << endl <<
 					"\"am0 --help\" gives further information." << endl;
@@ -43,14 +129,19 @@ int main(int argc, char** argv) {
 		}
 		else {
 			if (i == argc - 1) {
-				ifstream fs { argv[i] };
+				fs.open(argv[i]);
 				if (fs.fail()) {
 					cerr << "Could not open file '" << argv[i] << "'" << endl;
 					return 1;
 				}
+				file = true;
+				prog_name = argv[i];
+				//the file is parsed while running if streaming is enabled
+				if (streaming) continue;
 				//parse from file
+				perf_start();
 				if (!prog.parse_prog(fs, FILE_T)) return 1;
-				file = true;
+				perf_stop("parse");
 			}
 			else {
 				//parse from stdin
@@ -60,8 +151,22 @@ int main(int argc, char** argv) {
 			}
 		}
 	}
+	if (streaming && (state || debugging || skip_steps || residual_file != "" || analyzing)) {
+		cerr << __PROG_NAME__ << ": An initial state, the debugger, fast forwarding, specializing or analyzing can't be used while streaming" << endl;
+		return 1;
+	}
+	//the compiled loops run many instructions at once and are compiled from the complete code
+	if (tiering && (streaming || debugging || logging)) {
+		cerr << __PROG_NAME__ << ": Tiered execution can't be used while streaming, with the debugger or with logging" << endl;
+		return 1;
+	}
+	if (tiering) prog.tiered();
 	//parse inital state if enabled
-	if (!file && !prog.parse_prog()) return 1;
+	if (!file && !streaming) {
+		perf_start();
+		if (!prog.parse_prog()) return 1;
+		perf_stop("parse");
+	}
 	if (state) {
 		bool once = true;
 		while (!prog.parse_state()) {
@@ -75,10 +180,66 @@ int main(int argc, char** argv) {
 			}
 		}
 	}
+	//analyze the program statically instead of running it
+	if (analyzing) {
+		prog.analyze();
+		return 0;
+	}
+	//partially evaluate the program instead of running it
+	if (residual_file != "") {
+		ofstream rs {residual_file};
+		if (rs.fail()) {
+			cerr << "Could not create file '" << residual_file << "'" << endl;
+			return 1;
+		}
+		if (!prog.specialize(known, rs)) {
+			cerr << "AM0 interpreter terminated with an error while specializing.\nLast machine state: " << prog << endl;
+			return 1;
+		}
+		cout << "Specialized program written to '" << residual_file << "'" << endl;
+		return 0;
+	}
+	//attach the input logs
+	io_log record_log, replay_log;
+	if (record_file != "" && !record_log.open_record(record_file)) {
+		cerr << "Could not create file '" << record_file << "'" << endl;
+		return 1;
+	}
+	if (replay_file != "" && !replay_log.open_replay(replay_file)) {
+		cerr << "Could not read a recorded log from '" << replay_file << "'" << endl;
+		return 1;
+	}
+	if (record_file != "") prog.record(record_log);
+	if (replay_file != "") prog.replay(replay_log);
+	//publish statistics in shared memory
+	shm_stats_segment segment;
+	if (publish) {
+		if (segment.create(__PROG_NAME__, prog_name)) prog.attach_stats(*segment.get());
+		else cerr << __PROG_NAME__ << ": Could not create the statistics segment" << endl;
+	}
+	if (detecting) prog.detect_loops();
+	//sample the thread running the machine
+	if (sample_interval && !prog.start_sampling(sample_interval)) {
+		cerr << __PROG_NAME__ << ": Could not start the sampling timer" << endl;
+		return 1;
+	}
 	//run the machine and show the final state at the end
-	if (cout << "Running the AM0 interpreter:" << endl && !prog.run(logging)) {
+	cout << "Running the AM0 interpreter:" << endl;
+	perf_start();
+	//while streaming the code is parsed and run at once
+	bool success = (!skip_steps || prog.fast_forward(skip_steps)) && (streaming ?
+		prog.run_streaming(file ? fs : cin, file, logging) : debugging ? prog.debug() : prog.run(logging));
+	perf_stop(streaming ? "stream" : "execute");
+	if (!success) {
 		cerr << "AM0 interpreter terminated with an error.\nLast machine state: " << prog << endl;
 	}
 	else cout << "Final state: " << prog << endl;
+	prog.write_samples(cout);
+	//report the performance counters of both phases
+	if (perf) {
+		if (!counters->available()) cerr << __PROG_NAME__ << ": Performance counters unavailable, only timing is reported" << endl;
+		if (perf_json) perf_counters::report_json(cerr, samples);
+		else perf_counters::report(cerr, samples);
+	}
 	return 0;
 }
@@ -1,6 +1,9 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <iomanip>
+#include <algorithm>
 #include "am0_interpreter.hpp"
 
 namespace am0_interpreter {
@@ -8,19 +11,402 @@ namespace am0_interpreter {
 	//if logging is true the machine state will be printed out after every command
 	bool am0::run(bool logging) {
 		am0_func_visitor afv {*this};
-		while (pc && (pc <= prog.size())) {
+		if (stats) stats->running.store(1, std::memory_order_relaxed);
+		//while streaming, wait for the parsing thread if the program counter is ahead of it
+		while (pc && steps < step_limit && (pc <= prog.size() || (stream && stream->fetch(prog, pc)))) {
 			if (logging) std::cout << *this << std::endl;
 			//run the function at programm counter
-			if (boost::apply_visitor(afv,prog[pc - 1])) continue;
-			else return false;
+			if (boost::apply_visitor(afv,prog[pc - 1])) {
+				++steps;
+				if (stats && !(steps & stats_interval)) publish_stats();
+				//the machine state is compared with an earlier one if non-termination is detected
+				if (steps < loop_check_at || check_loop()) continue;
+			}
+			if (stats) finish_stats();
+			return false;
+		}
+		if (stats) finish_stats();
+		if (pc && steps < step_limit) { std::cerr << "Program counter ran out of line" << std::endl; return false; }
+		return true;
+	}
+
+	//run until the machine halts, fails or waits for an input value
+	//a READ without supplied value leaves the program counter unchanged, so calling resume again after supply
+	//continues exactly at this READ. This way one thread can drive many machines without blocking on stdin
+	am0::run_state am0::resume(bool logging) {
+		suspendable = true;
+		suspended = false;
+		bool success = run(logging);
+		suspendable = false;
+		if (suspended) return run_state::input_needed;
+		return success ? run_state::halted : run_state::failed;
+	}
+
+	//provide the input value a suspended READ waits for
+	void am0::supply(int i) {
+		input = i;
+		has_input = true;
+	}
+
+	//deliver the values of WRITE to a callback instead of stdout
+	void am0::on_output(const std::function<void(int)>& f) {
+		output = f;
+	}
+
+	//publish statistics into a shared memory segment while running
+	void am0::attach_stats(shm_stats& s) {
+		stats = &s;
+	}
+
+	//stop the machine with an error if its state repeats without reading a value in between
+	//the program is deterministic, so it would loop forever
+	void am0::detect_loops(void) {
+		detecting_loops = true;
+		loop_state.clear();
+		loop_wait = loop_min_interval;
+		loop_check_at = steps + loop_min_interval;
+	}
+
+	//compare the machine state with the saved snapshot, returns false if it repeats
+	//by Brent's cycle detection the saved snapshot moves to the current state after a power of two comparisons,
+	//so every cycle is found within a few times its length. The comparisons are exact, a repeated state proves the loop
+	//comparisons are only made at the program counter of the saved snapshot, otherwise a cycle would only be seen
+	//after the least common multiple of its length and the interval between the comparisons
+	bool am0::check_loop(void) {
+		//a value read changes the future of the machine, so it starts over
+		bool fresh = loop_state.empty() || read_count != loop_reads;
+		if (!fresh && pc != (unsigned int) loop_state[0]) {
+			if (steps < loop_give_up) {
+				loop_check_at = steps + 1;
+				return true;
+			}
+			//the program counter may come back after a longer cycle
+			loop_wait *= 2;
+			fresh = true;
+		}
+		std::vector<int> state;
+		bool comparable = snapshot(state);
+		fresh = fresh || !comparable;
+		if (!fresh && state == loop_state) {
+			std::cerr << "Infinite loop. The machine state at step " << steps << " equals the state at step " << loop_step <<
+				", it repeats every " << steps - loop_step << " steps or a divisor of it\n\n";
+			return false;
+		}
+		if (fresh) {
+			loop_power = 1;
+			loop_checks = 0;
+		}
+		if (fresh || ++loop_checks == loop_power) {
+			if (comparable) loop_state.swap(state);
+			else loop_state.clear();
+			loop_step = steps;
+			loop_reads = read_count;
+			if (!fresh) loop_power *= 2;
+			loop_checks = 0;
+		}
+		//the interval grows with the state, so the comparisons only take a constant share of the run
+		loop_check_at = steps + std::max<unsigned long long>(loop_min_interval, 4 * loop_state.size());
+		loop_give_up = loop_check_at + loop_wait;
+		return true;
+	}
+
+	//append the complete state of the machine, the step counter isn't part of it
+	//returns false if the state can't be compared at the moment
+	bool am0::snapshot(std::vector<int>& s) const {
+		s.push_back(pc);
+		s.push_back(d_stack.size());
+		s.insert(s.end(), d_stack.begin(), d_stack.end());
+		for (auto& m : mem) {
+			s.push_back(m.first);
+			s.push_back(m.second);
+		}
+		return true;
+	}
+
+	//run hot loops from compiled code: backward jumps are counted per target line and once a loop is hot, it is
+	//compiled and the machine continues in the compiled loop at its header every time the jump is taken
+	void am0::tiered(void) {
+		tiering = true;
+		for (auto& f : prog) {
+			auto p = boost::get<std::pair<bool(*)(am0&,int),int>>(&f);
+			if (p && p->first == jmp) p->first = counted_jmp;
+			else if (p && p->first == jmc) p->first = counted_jmc;
+		}
+	}
+
+	//count a backward jump from line "from" to the program counter, the loop there is compiled from "code" once
+	//it is hot and the machine runs in the compiled loop from then on
+	void am0::tier_up(unsigned int from, const std::vector<std::string>& code) {
+		if (back_jumps.size() <= pc) back_jumps.resize(code.size() + 1);
+		unsigned int& count = back_jumps[pc];
+		if (count < hot_loop) { ++count; return; }
+		if (count > hot_loop) return;
+		auto l = compiled_loops.find(pc);
+		if (l == compiled_loops.end()) l = compiled_loops.emplace(pc, compile_loop(code, pc, from)).first;
+		if (l->second.valid) {
+			if (sampling) run_compiled<true>(l->second);
+			else run_compiled<false>(l->second);
 		}
-		if (pc) { std::cerr << "Program counter ran out of line" << std::endl; return false; }
+		//a loop which can't be compiled isn't looked up again
+		else count = hot_loop + 1;
+	}
+
+	//run the compiled loop "c" from its header, the program counter is at the header
+	//it stops at the first line outside the loop, before a pass could pass the step limit or the next comparison of
+	//the loop detection, or at an operation the interpreter has to run, e.g. to report an error. The machine is left
+	//in the state the interpreter would have at that line
+	//"sampled" is true while the sampling profiler runs, then the running operation is published for it
+	template<bool sampled> void am0::run_compiled(const compiled_loop& c) {
+		//the interpreter counts the backward jump the loop was entered by after it
+		unsigned long long limit = std::min(step_limit, loop_check_at);
+		if (steps + 1 + c.pass > limit) return;
+		limit -= 1 + c.pass;
+		//no operation in the loop changes which memory cells exist or where they are
+		compiled_cells.resize(c.cells.size());
+		for (size_t i = 0; i < c.cells.size(); ++i)
+			if (!(compiled_cells[i] = compiled_cell(c.cells[i].first, c.cells[i].second))) return;
+		int* const* cell = compiled_cells.data();
+		int frame = compiled_frame();
+		std::vector<int>& s = d_stack;
+		const micro_op* ops = c.ops.data();
+		const micro_op* o = ops;
+		unsigned long long n = steps;
+		unsigned long long publish_at = (n | stats_interval) + 1;
+		bool cond;
+		for (;;) {
+			if (sampled) compiled_op.store(o, std::memory_order_relaxed);
+			switch (o->op) {
+				case micro_op::lit: s.push_back(o->value); break;
+				case micro_op::load: s.push_back(*cell[o->cell]); break;
+				case micro_op::loada: s.push_back(o->value + (o->local ? frame : 0)); break;
+				case micro_op::store:
+					if (s.empty()) goto leave;
+					*cell[o->cell] = s.back();
+					s.pop_back();
+					break;
+				case micro_op::add: if (s.size() < 2) goto leave; s[s.size() - 2] += s.back(); s.pop_back(); break;
+				case micro_op::sub: if (s.size() < 2) goto leave; s[s.size() - 2] -= s.back(); s.pop_back(); break;
+				case micro_op::mul: if (s.size() < 2) goto leave; s[s.size() - 2] *= s.back(); s.pop_back(); break;
+				case micro_op::div:
+					if (s.size() < 2 || !s.back()) goto leave;
+					s[s.size() - 2] /= s.back();
+					s.pop_back();
+					break;
+				case micro_op::mod:
+					if (s.size() < 2 || !s.back()) goto leave;
+					s[s.size() - 2] %= s.back();
+					s.pop_back();
+					break;
+				case micro_op::lt: if (s.size() < 2) goto leave; s[s.size() - 2] = s[s.size() - 2] < s.back(); s.pop_back(); break;
+				case micro_op::eq: if (s.size() < 2) goto leave; s[s.size() - 2] = s[s.size() - 2] == s.back(); s.pop_back(); break;
+				case micro_op::ne: if (s.size() < 2) goto leave; s[s.size() - 2] = s[s.size() - 2] != s.back(); s.pop_back(); break;
+				case micro_op::gt: if (s.size() < 2) goto leave; s[s.size() - 2] = s[s.size() - 2] > s.back(); s.pop_back(); break;
+				case micro_op::le: if (s.size() < 2) goto leave; s[s.size() - 2] = s[s.size() - 2] <= s.back(); s.pop_back(); break;
+				case micro_op::ge: if (s.size() < 2) goto leave; s[s.size() - 2] = s[s.size() - 2] >= s.back(); s.pop_back(); break;
+				case micro_op::add_lit: if (s.empty()) goto leave; s.back() += o->value; break;
+				case micro_op::add_to_cell: *cell[o->cell] += o->value; break;
+				case micro_op::store_lit: *cell[o->cell] = o->value; break;
+				case micro_op::jmp: n += o->size; goto jump;
+				case micro_op::jmc:
+					if (s.empty() || (s.back() != 0 && s.back() != 1)) goto leave;
+					cond = s.back();
+					s.pop_back();
+					n += o->size;
+					if (!cond) goto jump;
+					++o;
+					continue;
+				case micro_op::branch_lit:
+				case micro_op::branch_cell: {
+					int first = *cell[o->cell], second = (o->op == micro_op::branch_lit) ? o->value : *cell[o->other];
+					switch (o->compare) {
+						case micro_op::lt: cond = first < second; break;
+						case micro_op::eq: cond = first == second; break;
+						case micro_op::ne: cond = first != second; break;
+						case micro_op::gt: cond = first > second; break;
+						case micro_op::le: cond = first <= second; break;
+						default: cond = first >= second; break;
+					}
+					n += o->size;
+					if (!cond) goto jump;
+					++o;
+					continue;
+				}
+			}
+			n += o->size;
+			++o;
+			continue;
+		jump:
+			if (o->next < 0) {
+				compiled_op.store(nullptr, std::memory_order_relaxed);
+				pc = o->target;
+				steps = n;
+				return;
+			}
+			//a pass through the loop ends at the header
+			if (!o->next) {
+				if (n > limit) break;
+				if (stats && n >= publish_at) {
+					steps = n;
+					publish_stats();
+					publish_at = (n | stats_interval) + 1;
+				}
+			}
+			o = ops + o->next;
+		}
+		compiled_op.store(nullptr, std::memory_order_relaxed);
+		pc = c.header;
+		steps = n;
+		return;
+	leave:
+		compiled_op.store(nullptr, std::memory_order_relaxed);
+		pc = o->line;
+		steps = n;
+	}
+
+	//line the machine is running, in a compiled loop the line of the running operation
+	unsigned int am0::running_line(void) const {
+		const micro_op* o = compiled_op.load(std::memory_order_relaxed);
+		return o ? o->line : pc;
+	}
+
+	//memory cell "adr" of a compiled loop, nullptr if it doesn't exist yet
+	int* am0::compiled_cell(bool, int adr) {
+		auto c = mem.find(adr);
+		return (c == mem.end()) ? nullptr : &c->second;
+	}
+
+	//sample the machine every "interval" microseconds of CPU time of the calling thread, which has to run it
+	bool am0::start_sampling(unsigned int interval) {
+		sampling.reset(new sampler(probe, this));
+		sample_interval = interval;
+		return sampling->start(interval);
+	}
+
+	//record the state of the machine "m" from the signal handler
+	void am0::probe(const void* m, sample& s) {
+		static_cast<const am0*>(m)->take_sample(s);
+	}
+
+	//record the state of the machine, it is interrupted by the signal, so nothing may be allocated or locked
+	void am0::take_sample(sample& s) const {
+		s.pc = running_line();
+		s.ref = 0;
+		s.depth = 0;
+	}
+
+	//stop sampling and report the lines the most samples were taken at
+	void am0::write_samples(std::ostream& os) {
+		if (!sampling) return;
+		sampling->stop();
+		std::vector<sample> samples = sampling->samples();
+		os << "Samples: " << samples.size() << ", one every " << sampling->stride() * sample_interval << "us of CPU time\n";
+		sampling.reset();
+		if (samples.empty()) return;
+		std::map<unsigned int,unsigned long> lines;
+		for (auto& s : samples) if (s.pc && s.pc <= source.size()) ++lines[s.pc];
+		std::vector<std::pair<unsigned long,unsigned int>> hot;
+		for (auto& l : lines) hot.push_back({l.second, l.first});
+		std::stable_sort(hot.begin(), hot.end(), [] (const std::pair<unsigned long,unsigned int>& a,
+			const std::pair<unsigned long,unsigned int>& b) { return a.first > b.first; });
+		if (hot.size() > hot_entries) hot.resize(hot_entries);
+		os << "Hot lines:\n";
+		for (auto& l : hot) os << std::fixed << std::setprecision(1) << std::setw(7) << 100.0 * l.first / samples.size() <<
+			"%  " << l.second << ": " << source[l.second - 1] << "\n";
+		write_sampled_procedures(os, samples);
+	}
+
+	//publish the current statistics
+	void am0::publish_stats() const {
+		publish_counters(0, mem.size());
+	}
+
+	//publish the final statistics, the machine isn't running anymore until it is run again
+	void am0::finish_stats(void) const {
+		publish_stats();
+		stats->running.store(0, std::memory_order_relaxed);
+	}
+
+	//publish the statistics common to all machines
+	//there is only one writer, so relaxed stores are enough
+	void am0::publish_counters(uint64_t rt_stack_depth, uint64_t memory) const {
+		stats->steps.store(steps, std::memory_order_relaxed);
+		stats->pc.store(pc, std::memory_order_relaxed);
+		stats->d_stack.store(d_stack.size(), std::memory_order_relaxed);
+		stats->rt_stack.store(rt_stack_depth, std::memory_order_relaxed);
+		stats->memory.store(memory, std::memory_order_relaxed);
+		stats->reads.store(read_count, std::memory_order_relaxed);
+		stats->writes.store(write_count, std::memory_order_relaxed);
+		stats->update_ns.store(monotonic_ns(), std::memory_order_relaxed);
+	}
+
+	//partially evaluate the program for the known input values
+	//the machine runs until it needs an unknown input value, halts or reaches "max_steps". Then a residual program
+	//is written, which rebuilds this state and continues with the part of the code still reachable from it
+	bool am0::specialize(const std::vector<int>& known, std::ostream& os, unsigned long long max_steps) {
+		std::vector<int> writes;
+		on_output([&] (int i) { writes.push_back(i); });
+		step_limit = max_steps;
+		size_t next = 0;
+		run_state state;
+		while ((state = resume()) == run_state::input_needed && next < known.size()) supply(known[next++]);
+		step_limit = ULLONG_MAX;
+		//the residual program only rebuilds the state of the machine itself, so its tasks finish first
+		bool stopped = state != run_state::failed && finish_tasks();
+		output = nullptr;
+		if (!stopped) return false;
+		std::vector<unsigned int> roots {pc};
+		std::vector<residual_line> prologue = residual_prologue(writes, roots);
+		write_residual(os, prologue, source, roots);
 		return true;
 	}
 
+	//write bounds of the instructions, the data stack depth and the memory cells used by every procedure
+	void am0::analyze(std::ostream& os) const {
+		write_analysis(os, source, false);
+	}
+
+	//code rebuilding the current state for a residual program
+	//"writes" are the values written so far, they are written again at the beginning
+	std::vector<residual_line> am0::residual_prologue(const std::vector<int>& writes, std::vector<unsigned int>&) const {
+		std::vector<residual_line> p;
+		//written values are stored at an address which is part of the final memory anyway
+		for (int v : writes) {
+			std::string adr = std::to_string(mem.begin()->first);
+			p.push_back({"LIT " + std::to_string(v) + ";", -1});
+			p.push_back({"STORE " + adr + ";", -1});
+			p.push_back({"WRITE " + adr + ";", -1});
+		}
+		for (auto& x : mem) {
+			p.push_back({"LIT " + std::to_string(x.second) + ";", -1});
+			p.push_back({"STORE " + std::to_string(x.first) + ";", -1});
+		}
+		for (int v : d_stack) p.push_back({"LIT " + std::to_string(v) + ";", -1});
+		p.push_back({"JMP ", (int) pc});
+		return p;
+	}
+
+	//parse code from "is" on a second thread and start running as soon as the first instructions are parsed
+	//the machine only waits if the program counter or a jump address is ahead of the parsed code
+	bool am0::run_streaming(std::istream& is, bool file, bool logging) {
+		prog_stream<am0_func> s;
+		stream = &s;
+		parsing = &s;
+		input_after_prog = (&is == &std::cin);
+		std::thread parser {[&] () { s.close(parse_prog(is, file)); }};
+		bool success = run(logging);
+		parser.join();
+		//take over the rest of the program, so the final state is printed correctly
+		s.fetch(prog, 0);
+		stream = nullptr;
+		parsing = nullptr;
+		input_after_prog = false;
+		return s.wait_closed() && success;
+	}
+
 	//sets the machine state to default
 	void am0::reset() {
 		pc = 1;
+		steps = 0;
 		d_stack.clear();
 		mem.clear();
 	}
@@ -41,66 +427,77 @@ namespace am0_interpreter {
 	//parse code into the machine
 	//file has to be true if "is" is a filestream in order to provide correct output
 	bool am0::parse_prog(std::istream& is, bool file) {
-		std::cout << "AM0 code:" << std::endl;
+		//the code listing would mix with the output of the running machine while streaming
+		null_ostream discard;
+		std::ostream& out = stream ? discard : std::cout;
+		out << "AM0 code:" << std::endl;
 		int lnr = 0;
 		std::string line;
-		while (std::cout << std::to_string(++lnr) << ": " && std::getline(is,line)) {
+		while (out << std::to_string(++lnr) << ": " && std::getline(is,line)) {
 			//Enable shebang, comment and new line support under UNIX like systems
 #if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
 			if (line == "" || line.substr(0,1) == "#") {
 				--lnr;
 				//move cursor back to start
-				if (file) std::cout << "\x1b[0G";
-				else std::cout << "\x1b[F";
+				if (file) out << "\x1b[0G";
+				else out << "\x1b[F";
 				//remove last line
-				std::cout << "\x1b[K";
+				out << "\x1b[K";
 				//print comments in blue and bold
-				if (line.substr(0,2) != "#!") std::cout << "\x1b[34;1m" << line << "\x1b[m\n";
+				if (line.substr(0,2) != "#!") out << "\x1b[34;1m" << line << "\x1b[m\n";
 				continue;
 			}
 #endif
-			if (file) std::cout << line << std::endl;
+			if (file) out << line << std::endl;
+			source.push_back(line);
 			std::stringstream ls {line};
 			std::string keyword;
 			int par;
 			ls >> keyword;
 			//read functions from "ls" and add them to program code container
-			if (keyword == "ADD;") { prog.push_back(add); continue; }
-			else if (keyword == "SUB;") { prog.push_back(sub); continue; }
-			else if (keyword == "MUL;") { prog.push_back(mul); continue; }
-			else if (keyword == "DIV;") { prog.push_back(div); continue; }
-			else if (keyword == "MOD;") { prog.push_back(mod); continue; }
-			else if (keyword == "LT;") { prog.push_back(lt); continue; }
-			else if (keyword == "EQ;") { prog.push_back(eq); continue; }
-			else if (keyword == "NE;") { prog.push_back(ne); continue; }
-			else if (keyword == "GT;") { prog.push_back(gt); continue; }
-			else if (keyword == "LE;") { prog.push_back(le); continue; }
-			else if (keyword == "GE;") { prog.push_back(ge); continue; }
+			if (keyword == "ADD;") { emit(add); continue; }
+			else if (keyword == "SUB;") { emit(sub); continue; }
+			else if (keyword == "MUL;") { emit(mul); continue; }
+			else if (keyword == "DIV;") { emit(div); continue; }
+			else if (keyword == "MOD;") { emit(mod); continue; }
+			else if (keyword == "LT;") { emit(lt); continue; }
+			else if (keyword == "EQ;") { emit(eq); continue; }
+			else if (keyword == "NE;") { emit(ne); continue; }
+			else if (keyword == "GT;") { emit(gt); continue; }
+			else if (keyword == "LE;") { emit(le); continue; }
+			else if (keyword == "GE;") { emit(ge); continue; }
 			else if (keyword == "LOAD") { if (ls.get() == ' ' && ls >> par && ls.get() == ';') {
-				prog.push_back(std::make_pair(load,par)); continue; }}
+				emit(std::make_pair(load,par)); continue; }}
 			else if (keyword == "LIT") { if (ls.get() == ' ' && ls >> par && ls.get() == ';') {
-				prog.push_back(std::make_pair(lit,par)); continue; }}
+				emit(std::make_pair(lit,par)); continue; }}
 			else if (keyword == "STORE") { if (ls.get() == ' ' && ls >> par && ls.get() == ';') {
-				prog.push_back(std::make_pair(store,par)); continue; }}
+				emit(std::make_pair(store,par)); continue; }}
 			else if (keyword == "JMP") { if (ls.get() == ' ' && ls >> par && ls.get() == ';') {
-				prog.push_back(std::make_pair(jmp,par)); continue; }}
+				emit(std::make_pair(tiering ? counted_jmp : jmp,par)); continue; }}
 			else if (keyword == "JMC") { if (ls.get() == ' ' && ls >> par && ls.get() == ';') {
-				prog.push_back(std::make_pair(jmc,par)); continue; }}
+				emit(std::make_pair(tiering ? counted_jmc : jmc,par)); continue; }}
 			else if (keyword == "READ") { if (ls.get() == ' ' && ls >> par && ls.get() == ';') {
-				prog.push_back(std::make_pair(read,par)); continue; }}
+				emit(std::make_pair(read,par)); continue; }}
 			else if (keyword == "WRITE") { if (ls.get() == ' ' && ls >> par && ls.get() == ';') {
-				prog.push_back(std::make_pair(write,par)); continue; }}
+				emit(std::make_pair(write,par)); continue; }}
 			return parse_error(is);
 		}
 		//Last code line number will be removed after input ends under UNIX like systems
 #if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
-		std::cout << "\x1b[0G\x1b[0K";
+		out << "\x1b[0G\x1b[0K";
 #endif
-		std::cout << std::endl;
+		out << std::endl;
 		is.clear();
 		return true;
 	}
 
+	//add a parsed function to the program code container
+	//while streaming it is handed over to the executing thread
+	void am0::emit(const am0_func& f) {
+		if (stream) stream->push(f);
+		else prog.push_back(f);
+	}
+
 	//parse a initial state into the machine
 	//input syntax: (program counter, data stack, [memory])
 	//multiple data stack elements are seperated by a colon
@@ -159,6 +556,113 @@ namespace am0_interpreter {
 		return true;
 	}
 
+	//run the machine under the interactive debugger
+	//breakpoints and watchpoints replace the affected lines by a trap, so the machine runs at full speed in between
+	bool am0::debug(std::istream& cmd) {
+		std::cout << "Debugger started, type \"h\" for help" << std::endl;
+		std::string line;
+		while (std::cout << "(amdb) " << std::flush && std::getline(cmd,line)) {
+			std::istringstream ls {line};
+			std::string c;
+			int par = 0;
+			if (!(ls >> c)) continue;
+			bool has_par = (bool) (ls >> par);
+			if (c == "h" || c == "help") {
+				std::cout << "  b, break LINE\t\tStop before running LINE\n" <<
+					"  d, delete LINE\tRemove the breakpoint at LINE\n" <<
+					"  w, watch ADR\t\tStop after writing to the memory address ADR\n" <<
+					"  u, unwatch ADR\tRemove the watchpoint at ADR\n" <<
+					"  i, info\t\tShow all breakpoints and watchpoints\n" <<
+					"  s, step\t\tRun the line at the program counter\n" <<
+					"  c, continue\t\tRun until a breakpoint or watchpoint is hit\n" <<
+					"  p, print\t\tPrint the state of the machine\n" <<
+					"  l, list\t\tList the code around the program counter\n" <<
+					"  q, quit\t\tStop debugging\n";
+			}
+			else if (c == "b" || c == "break") {
+				if (!has_par || par <= 0 || (size_t) par > source.size()) std::cerr << "Invalid line\n";
+				else { breakpoints.insert(par); repatch(); }
+			}
+			else if (c == "d" || c == "delete") {
+				if (!has_par || !breakpoints.erase(par)) std::cerr << "No breakpoint at this line\n";
+				else repatch();
+			}
+			else if (c == "w" || c == "watch") {
+				if (!has_par) std::cerr << "Invalid address\n";
+				else { watchpoints.insert(par); repatch(); }
+			}
+			else if (c == "u" || c == "unwatch") {
+				if (!has_par || !watchpoints.erase(par)) std::cerr << "No watchpoint at this address\n";
+				else repatch();
+			}
+			else if (c == "i" || c == "info") {
+				std::cout << "Breakpoints:";
+				for (auto b : breakpoints) std::cout << " " << b;
+				std::cout << "\nWatchpoints:";
+				for (auto w : watchpoints) std::cout << " " << w;
+				std::cout << std::endl;
+			}
+			else if (c == "p" || c == "print") { print_state(std::cout); std::cout << std::endl; }
+			else if (c == "l" || c == "list") {
+				unsigned int first = (pc > 5) ? pc - 5 : 1;
+				for (unsigned int l = first; l <= source.size() && l <= pc + 5; ++l)
+					std::cout << ((l == pc) ? "=>" : "  ") << (breakpoints.count(l) ? "*" : " ") << l << ": " << source[l - 1] << "\n";
+			}
+			else if (c == "s" || c == "step" || c == "c" || c == "continue") {
+				if (!pc || pc > source.size()) { std::cerr << "The program is not running\n"; continue; }
+				trapped = no_trap;
+				//a breakpoint at the program counter is stepped over
+				bool success = step_once();
+				if (success && (c == "c" || c == "continue")) success = run(false);
+				if (trapped == break_trap) std::cout << "Breakpoint at " << pc << ": " << source[pc - 1] << std::endl;
+				else if (trapped == watch_trap) std::cout << "Watchpoint " << watch_note << std::endl;
+				else if (!success) return false;
+				else if (!pc) { std::cout << "Program finished" << std::endl; return true; }
+				else if (pc <= source.size()) std::cout << pc << ": " << source[pc - 1] << std::endl;
+			}
+			else if (c == "q" || c == "quit") return true;
+			else std::cerr << "Unknown command '" << c << "'\n";
+		}
+		return true;
+	}
+
+	//run the function at program counter, ignoring a breakpoint there
+	bool am0::step_once() {
+		am0_func_visitor afv {*this};
+		resuming = true;
+		bool success = boost::apply_visitor(afv,prog[pc - 1]);
+		resuming = false;
+		if (success) ++steps;
+		return success;
+	}
+
+	//replace lines with breakpoints or writes to watched memory addresses by a trap, restore all other lines
+	void am0::repatch() {
+		watched_lines.clear();
+		for (unsigned int line = 1; line <= prog.size(); ++line) {
+			//memory addresses are constant in AM0, so only the lines writing to a watched address need a trap
+			std::istringstream ls {source[line - 1]};
+			std::string keyword;
+			int adr;
+			if (ls >> keyword && (keyword == "STORE" || keyword == "READ") && ls >> adr && watchpoints.count(adr))
+				watched_lines[line] = adr;
+			bool trap_needed = breakpoints.count(line) || watched_lines.count(line);
+			if (trap_needed && !patched.count(line)) {
+				patched[line] = prog[line - 1];
+				prog[line - 1] = trap;
+			}
+			else if (!trap_needed && patched.count(line)) {
+				prog[line - 1] = patched[line];
+				patched.erase(line);
+			}
+		}
+	}
+
+	//print out the state of the machine
+	void am0::print_state(std::ostream& os) const {
+		os << *this;
+	}
+
 	//prints out the state of the machine
 	std::ostream& operator<<(std::ostream& os,const am0& o) {
 		std::string ret = "(" + std::to_string(o.pc);
@@ -177,11 +681,11 @@ namespace am0_interpreter {
 	}
 
 	//applicators to functions in the program code container{
-	bool am0::am0_func_visitor::operator()(std::function<bool(am0&)>& f) {
+	bool am0::am0_func_visitor::operator()(bool(*f)(am0&)) {
 		return f(this->am0_machine);
 	}
 
-	bool am0::am0_func_visitor::operator()(std::pair<std::function<bool(am0&,int)>, int>& fc) {
+	bool am0::am0_func_visitor::operator()(std::pair<bool(*)(am0&,int), int>& fc) {
 		return fc.first(this->am0_machine,fc.second);
 	}
 
@@ -195,6 +699,68 @@ namespace am0_interpreter {
 	//}
 
 
+	//read a value from stdin or from the replayed log
+	bool am0::read_input(int& i) {
+		++read_count;
+		//the machine may wait a long time for input, so the statistics should show this state
+		if (stats) publish_stats();
+		if (replaying) {
+			unsigned long long step;
+			if (!replaying->next(i,step)) { std::cerr << "No more values in the replayed log\n\n"; return false; }
+			//a different step means a different program or initial state than in the recorded run
+			if (step != steps) {
+				std::cerr << "Replay diverged: value recorded at step " << step << ", read at step " << steps << "\n\n";
+				return false;
+			}
+			if (!quiet) std::cout << " In: " << i << std::endl;
+			return true;
+		}
+		//suspend the machine until the host supplies a value
+		if (suspendable) {
+			if (!has_input) { --read_count; suspended = true; return false; }
+			i = input;
+			has_input = false;
+			if (recording) recording->put(i,steps);
+			return true;
+		}
+		//a streamed program from stdin is followed by the input values, so the code has to be read first
+		if (input_after_prog) parsing->wait_closed();
+		if (!quiet) std::cout << " In: ";
+		std::cin >> i;
+		if (std::cin.fail()) { std::cin.clear(); std::cerr << "Wrong input\n\n"; return false; }
+		if (recording) recording->put(i,steps);
+		return true;
+	}
+
+	//write a value to stdout or to the output callback
+	void am0::write_output(int i) {
+		++write_count;
+		if (quiet) return;
+		if (output) output(i);
+		else std::cout << "Out: " << i << std::endl;
+	}
+
+	//record all values read by the machine into a log
+	void am0::record(io_log& log) {
+		recording = &log;
+	}
+
+	//read all values from a recorded log instead of stdin
+	void am0::replay(io_log& log) {
+		replaying = &log;
+	}
+
+	//run without any output up to a given step
+	//the machine can be run normally afterwards, e.g. with logging or under the debugger
+	bool am0::fast_forward(unsigned long long step) {
+		step_limit = step;
+		quiet = true;
+		bool success = run(false);
+		step_limit = ULLONG_MAX;
+		quiet = false;
+		return success;
+	}
+
 	//check if "adr" is valid memory address
 	bool am0::address_is_valid(int address, bool check_load) const {
 		if (address < 0 || (check_load && !mem.count(address))) {
@@ -207,8 +773,10 @@ namespace am0_interpreter {
 	//check if "jmp_address" is a valid jump address
 	//if "check_loop" is true the jump address can't be equal to the current program counter
 	bool am0::jmp_address_is_valid(int jmp_address, bool check_loop) const {
-		if (jmp_address < 0 || (size_t) jmp_address > prog.size()) {
-			std::cerr << "Invalid jump address. Possible range [0-" + std::to_string(prog.size()) + "]\n\n";
+		//while streaming the jump address may not be parsed yet
+		size_t size = (stream && jmp_address > 0 && (size_t) jmp_address > prog.size()) ? stream->wait(jmp_address) : prog.size();
+		if (jmp_address < 0 || (size_t) jmp_address > size) {
+			std::cerr << "Invalid jump address. Possible range [0-" + std::to_string(size) + "]\n\n";
 			return false;
 		}
 		if (check_loop && (unsigned int) jmp_address == pc) {
@@ -219,7 +787,8 @@ namespace am0_interpreter {
 	}
 
 	//perform a binary operation on data stack
-	bool am0::perform_bin_op(const std::function<void(int,int&)>& f) {
+	//"f" is a template parameter, so every operation gets its own inlined copy
+	template<typename F> bool am0::perform_bin_op(F f) {
 		if (!enough_arguments_on_stack(2)) return false;
 		//use the function like: f(data stack@end,data stack@(end-1))
 		//where f stores its result at data stack@(end-1)
@@ -316,15 +885,32 @@ namespace am0_interpreter {
 
 	//operation: JMP e
 	bool am0::jmp(am0& a, int par) {
-		if (!a.jmp_address_is_valid(par, true)) return false;
+		if (!a.am0::jmp_address_is_valid(par, true)) return false;
 		//change the program counter to jump address
 		a.pc = par;
 		return true;
 	}
 
+	//operation: JMP e with tiered execution
+	//a backward jump is counted for its target, the machine continues in the compiled loop there once it is hot
+	bool am0::counted_jmp(am0& a, int par) {
+		unsigned int from = a.pc;
+		if (!jmp(a, par)) return false;
+		if (a.pc && a.pc < from) a.tier_up(from, a.source);
+		return true;
+	}
+
+	//operation: JMC e with tiered execution, counted like JMP if it jumps back
+	bool am0::counted_jmc(am0& a, int par) {
+		unsigned int from = a.pc;
+		if (!jmc(a, par)) return false;
+		if (a.pc && a.pc < from) a.tier_up(from, a.source);
+		return true;
+	}
+
 	//operation: JMC e
 	bool am0::jmc(am0& a, int par) {
-		if (!a.jmp_address_is_valid(par) || !a.enough_arguments_on_stack(1)) return false;
+		if (!a.am0::jmp_address_is_valid(par) || !a.enough_arguments_on_stack(1)) return false;
 		//if the value at the end of the data stack is 0 pc will be changed to jump address
 		if (a.d_stack.back() == 0) a.pc = par;
 		//if the value at the end of the data stack is 1 pc will increased normaly
@@ -339,9 +925,8 @@ namespace am0_interpreter {
 	bool am0::read(am0& a, int par) {
 		if (!a.address_is_valid(par)) return false;
 		int i;
-		std::cout << " In: "; std::cin >> i;
 		//get value from stdin and store this value at memory address on memory
-		if (std::cin.fail()) { std::cin.clear(); std::cerr << "Wrong input\n\n"; return false; }
+		if (!a.read_input(i)) return false;
 		a.mem[par] = i;
 		++a.pc;
 		return true;
@@ -351,8 +936,28 @@ namespace am0_interpreter {
 	bool am0::write(am0& a, int par) {
 		if (!a.address_is_valid(par, true)) return false;
 		//write value at memory address from memory to stdout
-		std::cout << "Out: " << a.mem[par] << std::endl;
+		a.write_output(a.mem[par]);
 		++a.pc;
 		return true;
 	}
+
+	//operation: trap of the debugger
+	bool am0::trap(am0& a) {
+		unsigned int line = a.pc;
+		//breakpoint: stop before running the original line
+		if (!a.resuming && a.breakpoints.count(line)) { a.trapped = break_trap; return false; }
+		a.resuming = false;
+		am0_func_visitor afv {a};
+		auto w = a.watched_lines.find(line);
+		if (w == a.watched_lines.end()) return boost::apply_visitor(afv,a.patched[line]);
+		//watchpoint: run the original line and stop afterwards
+		std::string old = a.mem.count(w->second) ? std::to_string(a.mem[w->second]) : "-";
+		if (!boost::apply_visitor(afv,a.patched[line])) return false;
+		a.watch_note = "[" + std::to_string(w->second) + "]: " + old + " -> " + std::to_string(a.mem[w->second]) +
+			" at line " + std::to_string(line);
+		a.trapped = watch_trap;
+		//the original line has been run, even though the machine stops
+		++a.steps;
+		return false;
+	}
 }
@@ -1,50 +1,160 @@
+#include <atomic>
 #include <map>
+#include <memory>
+#include <set>
+#include <string>
 #include <vector>
 #include <utility>
 #include <iostream>
 #include <boost/variant.hpp>
 #include <functional>
+#include <climits>
+#include "prog_stream.hpp"
+#include "io_log.hpp"
+#include "shm_stats.hpp"
+#include "specializer.hpp"
+#include "analyzer.hpp"
+#include "sampler.hpp"
+#include "tiered.hpp"
 
 namespace am0_interpreter {
 	class am0 {
 		public:
+			enum class run_state {halted, failed, input_needed}; //reason for resume to return
+
 			virtual bool run(bool = false); //starts the machine
+			run_state resume(bool = false); //run until the machine halts, fails or waits for an input value
+			void supply(int); //provide the input value a suspended READ waits for
+			void on_output(const std::function<void(int)>&); //deliver the values of WRITE to a callback
+			void attach_stats(shm_stats&); //publish statistics while running
+			bool start_sampling(unsigned int); //sample the machine every given microseconds of CPU time
+			void write_samples(std::ostream&); //stop sampling and report the hot lines
+			void detect_loops(void); //stop the machine if its state repeats without reading a value
+			virtual void tiered(void); //run hot loops from compiled code
+			bool specialize(const std::vector<int>&, std::ostream&, unsigned long long = 1ull << 32); //partial evaluation
+			virtual void analyze(std::ostream& = std::cout) const; //estimate the costs without running
+			virtual bool run_streaming(std::istream& = std::cin, bool = false, bool = false); //parse and run at once
 			virtual void reset(void); //sets the machine state to default
 			virtual bool parse_prog(std::istream& = std::cin, bool = false); //parse code into the machine
 			virtual bool parse_state(std::istream& = std::cin); //parse a initial state to the machine
+			virtual bool debug(std::istream& = std::cin); //run the machine under the interactive debugger
+			void record(io_log&); //record all values read by the machine into a log
+			void replay(io_log&); //read all values from a recorded log instead of stdin
+			bool fast_forward(unsigned long long); //run without any output up to a given step
 			virtual ~am0() {}
 			friend std::ostream& operator<<(std::ostream&,const am0&); //print out the state of the machine
 		private:
 			typedef boost::variant<
-				std::function<bool(am0&)>,
-				std::pair<std::function<bool(am0&,int)>,int>
+				bool(*)(am0&),
+				std::pair<bool(*)(am0&,int),int>
 			> am0_func;
 
 			class am0_func_visitor : public boost::static_visitor<bool> {
 				public:
 					am0_func_visitor(am0& a) : am0_machine(a) {}
-					bool operator()(std::function<bool(am0&)>&);
-					bool operator()(std::pair<std::function<bool(am0&,int)>,int>&);
+					bool operator()(bool(*)(am0&));
+					bool operator()(std::pair<bool(*)(am0&,int),int>&);
 				private:
 					am0& am0_machine;
 			};
 
 			std::vector<am0_func> prog; //program code container
 			std::map<int,int> mem; //memory: relation between memory addresses and memory values
+			prog_stream<am0_func>* stream = nullptr; //instructions of the parsing thread while streaming
+
+			std::map<unsigned int,am0_func> patched; //original functions of the lines replaced by a trap
+			std::map<unsigned int,int> watched_lines; //lines writing to a watched memory address
 
+			void emit(const am0_func&); //add a parsed function to the program code container
 
 			bool address_is_valid(int,bool = false) const; //check if a given memory address is valid
 
 			static bool load(am0&,int), store(am0&,int);
 			static bool read(am0&,int), write(am0&,int);
+			static bool trap(am0&);
+			static bool counted_jmp(am0&,int), counted_jmc(am0&,int);
+			static void probe(const void*, sample&); //record the state of a machine from the signal handler
+
+			std::unique_ptr<sampler> sampling; //sampling profiler
+
+			//non-termination detection by Brent's cycle detection on snapshots of the machine state {
+			bool detecting_loops = false;
+			std::vector<int> loop_state; //saved snapshot, empty if there is none
+			unsigned long long loop_step = 0; //step of the saved snapshot
+			unsigned long long loop_reads = 0; //values read before the saved snapshot
+			unsigned long long loop_power = 1, loop_checks = 0; //comparisons until the saved snapshot moves on
+			unsigned long long loop_wait = 1024; //steps to wait for the program counter of the saved snapshot
+			unsigned long long loop_give_up = 0; //step to start over if the program counter didn't come back
+			enum {loop_min_interval = 1024}; //fewest steps between two comparisons
+			//}
 		protected:
 			unsigned int pc = 1; //program counter
 			std::vector<int> d_stack; //data stack
+			prog_stream_base* parsing = nullptr; //parsing thread while streaming
+			bool input_after_prog = false; //input values follow the streamed program code on stdin
+			unsigned long long steps = 0; //amount of functions run so far
+			unsigned long long step_limit = ULLONG_MAX; //stop running after this step
+			bool quiet = false; //suppress the output of WRITE
+			io_log* recording = nullptr; //log to record read values into
+			io_log* replaying = nullptr; //log to replay read values from
+			bool suspendable = false; //READ suspends the machine instead of reading from stdin
+			bool suspended = false; //the machine stopped at READ because no input value was supplied
+			bool has_input = false; //an input value was supplied
+			int input = 0; //the supplied input value
+			std::function<void(int)> output; //callback for the values of WRITE
+			shm_stats* stats = nullptr; //statistics published while running
+			unsigned long long read_count = 0; //values read by READ
+			unsigned long long write_count = 0; //values written by WRITE
+			enum {stats_interval = 0xfff}; //statistics are published every 4096 steps
+			unsigned int sample_interval = 0; //microseconds of CPU time between two samples
+			unsigned long long loop_check_at = ULLONG_MAX; //step of the next comparison of the machine state
+			enum {hot_entries = 10}; //lines and procedures reported by sampling
+
+			//tiered execution of hot loops {
+			bool tiering = false; //backward jumps are counted and hot loops run compiled
+			std::vector<unsigned int> back_jumps; //backward jumps taken per target line
+			std::map<unsigned int,compiled_loop> compiled_loops; //loops by their header, also the invalid ones
+			std::vector<int*> compiled_cells; //memory cells of the running compiled loop
+			//operation of the running compiled loop, read by the sampling profiler
+			//it is atomic, so the compiler can't keep it in a register or drop stores the signal handler would see
+			std::atomic<const micro_op*> compiled_op {nullptr};
+			enum {hot_loop = 100}; //backward jumps to a line until the loop there is compiled
+			void tier_up(unsigned int, const std::vector<std::string>&); //count a backward jump from a line
+			template<bool> void run_compiled(const compiled_loop&); //run a compiled loop from its header
+			unsigned int running_line(void) const; //line of the running instruction, also in a compiled loop
+			virtual int* compiled_cell(bool, int); //memory cell of a compiled loop, nullptr if it isn't valid
+			virtual int compiled_frame(void) const { return 0; } //added to the local addresses of LOADA
+			//}
+
+			virtual void publish_stats(void) const; //publish the current statistics
+			virtual void take_sample(sample&) const; //record the state of the machine, called by the signal handler
+			virtual bool snapshot(std::vector<int>&) const; //append the complete state of the machine
+			bool check_loop(void); //compare the machine state with the saved one
+			virtual void write_sampled_procedures(std::ostream&, const std::vector<sample>&) const {} //report procedures
+			void publish_counters(uint64_t, uint64_t) const; //publish the statistics common to all machines
+			void finish_stats(void) const; //publish the final statistics when the machine stops running
+			virtual bool finish_tasks(void) { return true; } //finish the work left parked where the machine stopped
+			//code rebuilding the current state for a residual program
+			virtual std::vector<residual_line> residual_prologue(const std::vector<int>&, std::vector<unsigned int>&) const;
+			std::vector<std::string> source; //code line of every function in the program code container
+
+			enum trap_reason {no_trap, break_trap, watch_trap}; //reason for the last stop of the debugger
+			trap_reason trapped = no_trap;
+			bool resuming = false; //step over a breakpoint at the program counter
+			std::set<unsigned int> breakpoints; //lines to stop at before running them
+			std::set<int> watchpoints; //addresses to stop at after writing them
+			std::string watch_note; //change of the watched address at the last watchpoint
+
+			virtual bool step_once(void); //run the function at program counter, ignoring a breakpoint there
+			virtual void repatch(void); //replace lines with breakpoints or watched writes by a trap
+			virtual void print_state(std::ostream&) const; //print out the state of the machine
 
 			virtual bool jmp_address_is_valid(int,bool = false) const; //check if a jump address is valid
 			bool enough_arguments_on_stack(int) const; //check if enough arguments are on data stack
+			bool read_input(int&); //read a value from stdin
+			void write_output(int); //write a value to stdout
 
-			bool perform_bin_op(const std::function<void(int,int&)>&); //perform a binary operation on data stack
+			template<typename F> bool perform_bin_op(F); //perform a binary operation on data stack
 			static bool add(am0&), sub(am0&), mul(am0&), div(am0&), mod(am0&);
 			static bool lt(am0&), eq(am0&), ne(am0&), gt(am0&), le(am0&), ge(am0&);
 			static bool lit(am0&,int), jmp(am0&,int), jmc(am0&,int);
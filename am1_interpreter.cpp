@@ -1,4 +1,7 @@
 #include <sstream>
+#include <algorithm>
+#include <iomanip>
+#include <thread>
 #include "am1_interpreter.hpp"
 
 namespace am1_interpreter {
@@ -6,22 +9,165 @@ namespace am1_interpreter {
 	//if logging is true the machine state will be printed out after every command
 	bool am1::run(bool logging) {
 		am1_func_visitor afv {*this};
-		while (pc && (pc <= prog.size())) {
+		if (stats) stats->running.store(1, std::memory_order_relaxed);
+		//while streaming, wait for the parsing thread if the program counter is ahead of it
+		while (pc && steps < step_limit && (pc <= prog.size() || (stream && stream->fetch(prog, pc)))) {
 			if (logging) std::cout << *this << std::endl;
 			//run the function at programm counter
-			if (boost::apply_visitor(afv,prog[pc - 1])) continue;
-			else return false;
+			if (boost::apply_visitor(afv,prog[pc - 1])) {
+				++steps;
+				if (stats && !(steps & stats_interval)) publish_stats();
+				//the machine state is compared with an earlier one if non-termination is detected
+				if (steps < loop_check_at || check_loop()) continue;
+			}
+			if (stats) finish_stats();
+			//at a trap or a suspended READ the tasks stay parked, they continue when the machine does
+			if (trapped != no_trap || suspended) return false;
+			join_children();
+			pool.reset();
+			return false;
+		}
+		//so do they if the machine only stopped at the step limit, e.g. after fast forwarding
+		if (pc && steps >= step_limit) {
+			if (stats) finish_stats();
+			return true;
 		}
+		//tasks still running are finished before the machine stops
+		bool success = join_children();
+		pool.reset();
+		//all blocks are freed at once at the end of the program
+		if (!pc && heap) heap->reset();
+		if (stats) finish_stats();
 		if (pc) { std::cerr << "Program counter ran out of line" << std::endl; return false; }
-		return true;
+		return success;
+	}
+
+	//run a spawned task until its procedure returns
+	//the task shares the code of the root, so the program counter is checked against the code of the root
+	bool am1::run_task() {
+		am1_func_visitor afv {*this};
+		bool success = true;
+		while (pc && (pc <= root->prog.size() || (root->stream && root->stream->fetch(root->prog, pc)))) {
+			if (!boost::apply_visitor(afv,root->prog[pc - 1])) { success = false; break; }
+			++steps;
+		}
+		if (success && pc) { std::cerr << "Program counter ran out of line" << std::endl; success = false; }
+		return join_children() && success;
+	}
+
+	//wait for all children and unseal the segments sealed by this machine
+	//the waiting machine runs queued tasks meanwhile, so waiting never blocks a worker
+	bool am1::join_children() {
+		if (children.empty()) return true;
+		while (pending.load(std::memory_order_acquire)) if (!root->pool->run_one()) std::this_thread::yield();
+		bool success = true;
+		for (auto& c : children) {
+			steps += c->steps;
+			if (!c->task_succeeded) {
+				if (success) std::cerr << "Spawned task failed. Last task state: " << *c << "\n\n";
+				success = false;
+			}
+		}
+		children.clear();
+		//no other task can access the own segments anymore, so their cells move back to the runtime stack
+		std::vector<int> cells;
+		for (; owned; --owned) {
+			std::vector<int> s;
+			for (auto& x : sealed->cells) s.push_back(x.load(std::memory_order_relaxed));
+			cells.insert(cells.begin(), s.begin(), s.end());
+			base = sealed->first;
+			sealed = sealed->below;
+		}
+		rt_stack.insert(rt_stack.begin(), cells.begin(), cells.end());
+		return success;
+	}
+
+	//give the machine a heap of the given number of cells
+	//the heap is empty again after the program ended or the machine is reset
+	void am1::enable_heap(unsigned int size) {
+		heap.reset(new heap_arena(size));
+	}
+
+	//profile the procedures called from now on, the machine is in the procedure at the program counter
+	//instructions of spawned tasks count for the procedure joining them
+	void am1::profile(void) {
+		profiler.reset(new call_profiler(pc, steps));
+	}
+
+	//write the call profile to "summary" and the collapsed call stacks for flamegraph tools to "collapsed"
+	//all procedures still running are left first
+	void am1::write_profile(std::ostream& summary, std::ostream& collapsed) {
+		if (!profiler) return;
+		auto name = [this] (unsigned int l) { return procedure_name(l); };
+		profiler->finish(steps);
+		profiler->write_summary(summary, name);
+		profiler->write_collapsed(collapsed, name);
+		profiler.reset();
+	}
+
+	//name of the procedure at line "l" taken from the comment line before it, e.g. "#double(x,*y)"
+	std::string am1::procedure_name(unsigned int l) const {
+		auto c = comments.find(l);
+		std::string name = (c == comments.end()) ? "" : c->second.substr(1);
+		name.erase(0, name.find_first_not_of(" \t"));
+		name.erase(name.find_last_not_of(" \t") + 1);
+		//';' seperates the procedures of a collapsed call stack
+		std::replace(name.begin(), name.end(), ';', ',');
+		return (name == "") ? "line " + std::to_string(l) : name;
+	}
+
+	//run hot loops from compiled code
+	void am1::tiered(void) {
+		tiering = true;
+		for (auto& f : prog) {
+			auto p = boost::get<std::pair<bool(*)(am1&,int),int>>(&f);
+			if (p && p->first == jmp) p->first = counted_jmp;
+			else if (p && p->first == jmc) p->first = counted_jmc;
+		}
+	}
+
+	//cell at memory address "adr" of a compiled loop, nullptr if it isn't on the runtime stack of the machine
+	//no operation of a compiled loop changes ref or the size of the runtime stack, so the cell stays valid in it
+	int* am1::compiled_cell(bool local, int adr) {
+		unsigned int i = adr - 1 + (local ? ref : 0) - base;
+		return (i < rt_stack.size()) ? &rt_stack[i] : nullptr;
+	}
+
+	//run spawned tasks on the given number of worker threads
+	//the thread running the machine is one of them
+	void am1::parallel(unsigned int n) {
+		workers = n;
+	}
+
+	//parse code from "is" on a second thread and start running as soon as the first instructions are parsed
+	//the machine only waits if the program counter, a jump or a return address is ahead of the parsed code
+	bool am1::run_streaming(std::istream& is, bool file, bool logging) {
+		am0_interpreter::prog_stream<am1_func> s;
+		stream = &s;
+		parsing = &s;
+		input_after_prog = (&is == &std::cin);
+		std::thread parser {[&] () { s.close(parse_prog(is, file)); }};
+		bool success = run(logging);
+		parser.join();
+		//take over the rest of the program, so the final state is printed correctly
+		s.fetch(prog, 0);
+		stream = nullptr;
+		parsing = nullptr;
+		input_after_prog = false;
+		return s.wait_closed() && success;
 	}
 
 	//sets the machine state to default
 	void am1::reset(void) {
 		pc = 1;
+		steps = 0;
 		d_stack.clear();
 		rt_stack.clear();
 		ref = 0;
+		base = 0;
+		sealed.reset();
+		owned = 0;
+		if (heap) heap->reset();
 	}
 
 	//print out a error message
@@ -40,66 +186,78 @@ namespace am1_interpreter {
 	//parse code into the machine
 	//file has to be true if "is" is a filestream in order to provide correct output
 	bool am1::parse_prog(std::istream& is, bool file) {
-		std::cout << "AM1 code:" << std::endl;
+		//the code listing would mix with the output of the running machine while streaming
+		am0_interpreter::null_ostream discard;
+		std::ostream& out = stream ? discard : std::cout;
+		out << "AM1 code:" << std::endl;
 		int lnr = 0;
 		std::string line;
-		while (std::cout << std::to_string(++lnr) << ": " && std::getline(is,line)) {
+		while (out << std::to_string(++lnr) << ": " && std::getline(is,line)) {
 			//Enable shebang, comment and new line support under UNIX like systems
 #if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
 			if (line == "" || line.substr(0,1) == "#") {
 				--lnr;
 				//move cursor back to start
-				if (file) std::cout << "\x1b[0G";
-				else std::cout << "\x1b[F";
+				if (file) out << "\x1b[0G";
+				else out << "\x1b[F";
 				//remove last line
-				std::cout << "\x1b[K";
+				out << "\x1b[K";
 				//print comments in blue and bold
-				if (line.substr(0,2) != "#!") std::cout << "\x1b[34;1m" << line << "\x1b[m\n";
+				if (line.substr(0,2) != "#!") out << "\x1b[34;1m" << line << "\x1b[m\n";
+				//procedures are named by the first line of the comment block before them in the profile
+				if (line == "") comments.erase(source.size() + 1);
+				else if (line.substr(0,2) != "#!") comments.emplace(source.size() + 1, line);
 				continue;
 			}
 #endif
-			if (file) std::cout << line << std::endl;
+			if (file) out << line << std::endl;
+			source.push_back(line);
 			std::stringstream ls {line};
 			std::string keyword;
 			int par;
 			ls >> keyword;
 			//read functions from "ls" and add them to program code container
-			if (keyword == "ADD;") { prog.push_back(am0::add); continue; }
-			else if (keyword == "SUB;") { prog.push_back(sub); continue; }
-			else if (keyword == "MUL;") { prog.push_back(mul); continue; }
-			else if (keyword == "DIV;") { prog.push_back(div); continue; }
-			else if (keyword == "MOD;") { prog.push_back(mod); continue; }
-			else if (keyword == "LT;") { prog.push_back(lt); continue; }
-			else if (keyword == "EQ;") { prog.push_back(eq); continue; }
-			else if (keyword == "NE;") { prog.push_back(ne); continue; }
-			else if (keyword == "GT;") { prog.push_back(gt); continue; }
-			else if (keyword == "LE;") { prog.push_back(le); continue; }
-			else if (keyword == "GE;") { prog.push_back(ge); continue; }
-			else if (keyword == "PUSH;") { prog.push_back(push); continue; }
+			if (keyword == "ADD;") { emit(am0::add); continue; }
+			else if (keyword == "SUB;") { emit(sub); continue; }
+			else if (keyword == "MUL;") { emit(mul); continue; }
+			else if (keyword == "DIV;") { emit(div); continue; }
+			else if (keyword == "MOD;") { emit(mod); continue; }
+			else if (keyword == "LT;") { emit(lt); continue; }
+			else if (keyword == "EQ;") { emit(eq); continue; }
+			else if (keyword == "NE;") { emit(ne); continue; }
+			else if (keyword == "GT;") { emit(gt); continue; }
+			else if (keyword == "LE;") { emit(le); continue; }
+			else if (keyword == "GE;") { emit(ge); continue; }
+			else if (keyword == "PUSH;") { emit(push); continue; }
 			else if (keyword == "LIT") { if (ls.get() == ' ' && ls >> par && ls.get() == ';') {
-				prog.push_back(std::make_pair(lit,par)); continue; }}
+				emit(std::make_pair(lit,par)); continue; }}
 			else if (keyword == "JMP") { if (ls.get() == ' ' && ls >> par && ls.get() == ';') {
-				prog.push_back(std::make_pair(jmp,par)); continue; }}
+				emit(std::make_pair(tiering ? counted_jmp : jmp,par)); continue; }}
 			else if (keyword == "JMC") { if (ls.get() == ' ' && ls >> par && ls.get() == ';') {
-				prog.push_back(std::make_pair(jmc,par)); continue; }}
+				emit(std::make_pair(tiering ? counted_jmc : jmc,par)); continue; }}
 			else if (keyword == "CALL") { if (ls.get() == ' ' && ls >> par && ls.get() == ';') {
-				prog.push_back(std::make_pair(call,par)); continue; }}
+				emit(std::make_pair(call,par)); continue; }}
 			else if (keyword == "INIT") { if (ls.get() == ' ' && ls >> par && ls.get() == ';') {
-				prog.push_back(std::make_pair(init,par)); continue; }}
+				emit(std::make_pair(init,par)); continue; }}
 			else if (keyword == "RET") { if (ls.get() == ' ' && ls >> par && ls.get() == ';') {
-				prog.push_back(std::make_pair(ret,par)); continue; }}
+				emit(std::make_pair(ret,par)); continue; }}
+			else if (keyword == "SPAWN") { int n; if (ls.get() == ' ' && ls >> par && ls.get() == ',' && ls >> n &&
+				ls.get() == ';') { emit(std::make_tuple(spawn,par,n)); continue; }}
+			else if (keyword == "JOIN;") { emit(join); continue; }
+			else if (keyword == "ALLOC;") { emit(alloc); continue; }
+			else if (keyword == "FREE;") { emit(dealloc); continue; }
 			else {
 				ls.seekg(0);
 				ls >> std::ws;
 				if ( !std::getline(ls,keyword,'(') ) return parse_error(is);
 				if (keyword == "LOADI") { if (ls >> par && ls.get() == ')') {
-					prog.push_back(std::make_pair(loadi,par)); continue;}}
+					emit(std::make_pair(indirect<load<global>>,par)); continue;}}
 				else if (keyword == "STOREI") { if (ls >> par && ls.get() == ')') {
-					prog.push_back(std::make_pair(storei,par)); continue;}}
+					emit(std::make_pair(indirect<store<global>>,par)); continue;}}
 				else if (keyword == "READI") { if (ls >> par && ls.get() == ')') {
-					prog.push_back(std::make_pair(readi,par)); continue;}}
+					emit(std::make_pair(indirect<read<global>>,par)); continue;}}
 				else if (keyword == "WRITEI") { if (ls >> par && ls.get() == ')') {
-					prog.push_back(std::make_pair(writei,par)); continue;}}
+					emit(std::make_pair(indirect<write<global>>,par)); continue;}}
 				else {
 					std::string visible;
 					if ( !std::getline(ls,visible,',') ) return parse_error(is);
@@ -109,56 +267,137 @@ namespace am1_interpreter {
 					else return parse_error(is);
 					if (keyword == "LOAD") {
 						if (ls >> par && ls.get() == ')' && ls.get() == ';') {
-							prog.push_back(std::make_tuple(load,v,par)); continue;}}
+							emit(std::make_pair((v == global) ? load<global> : load<local>,par)); continue;}}
 					else if (keyword == "STORE") {
 						if (ls >> par && ls.get() == ')' && ls.get() == ';') {
-							prog.push_back(std::make_tuple(store,v,par)); continue;}}
+							emit(std::make_pair((v == global) ? store<global> : store<local>,par)); continue;}}
 					else if (keyword == "READ") {
 						if (ls >> par && ls.get() == ')' && ls.get() == ';') {
-							prog.push_back(std::make_tuple(read,v,par)); continue;}}
+							emit(std::make_pair((v == global) ? read<global> : read<local>,par)); continue;}}
 					else if (keyword == "WRITE") {
 						if (ls >> par && ls.get() == ')' && ls.get() == ';') {
-							prog.push_back(std::make_tuple(write,v,par)); continue;}}
+							emit(std::make_pair((v == global) ? write<global> : write<local>,par)); continue;}}
 					else if (keyword == "LOADA") {
 						if (ls >> par && ls.get() == ')' && ls.get() == ';') {
-							prog.push_back(std::make_tuple(loada,v,par)); continue;}}
+							emit(std::make_pair((v == global) ? loada<global> : loada<local>,par)); continue;}}
 				}
 			}
 			return parse_error(is);
 		}
 		//Last code line number will be removed after input ends under UNIX like systems
 #if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
-		std::cout << "\x1b[0G\x1b[0K";
+		out << "\x1b[0G\x1b[0K";
 #endif
-		std::cout << std::endl;
+		out << std::endl;
 		is.clear();
 		return true;
 	}
 
+	//add a parsed function to the program code container
+	//while streaming it is handed over to the executing thread
+	void am1::emit(const am1_func& f) {
+		if (stream) stream->push(f);
+		else prog.push_back(f);
+	}
+
 	//check if "ra" is valid return address
 	bool am1::ra_address_is_valid(int ra) const {
-		if (ra <= 0 || (size_t) ra > prog.size()) {
-			std::cerr << "Invalid return address. Possible range [1-" + std::to_string(prog.size()) + "]\n\n";
+		//while streaming the return address may not be parsed yet
+		const auto& prog = root->prog;
+		auto stream = root->stream;
+		size_t size = (stream && ra > 0 && (size_t) ra > prog.size()) ? stream->wait(ra) : prog.size();
+		if (ra <= 0 || (size_t) ra > size) {
+			std::cerr << "Invalid return address. Possible range [1-" + std::to_string(size) + "]\n\n";
 			return false;
 		}
 		return true;
 	}
 
 	//check if "adr" is valid memory address
-	bool am1::address_is_valid(visibility s, int adr) const {
-		if ((s == global && (adr <= 0 || (size_t) adr > rt_stack.size())) ||
-			(s == local && ((adr + (int) ref) <= 0 || (size_t) ((int) ref + adr) > rt_stack.size()))) {
-				std::cerr << "Invalid memory address\n\n";
-				return false;
+	template<am1::visibility s> bool am1::address_is_valid(int adr) const {
+		//local addresses are relative to ref
+		int a = adr + ((s == local) ? (int) ref : 0);
+		if (a <= 0 || (size_t) a > base + rt_stack.size()) {
+			std::cerr << "Invalid memory address\n\n";
+			return false;
 		}
 		return true;
 	}
 
+	//value at the absolute memory address "adr", which has to be valid
+	inline int am1::cell(unsigned int adr) const {
+		if (adr > base && adr <= base + rt_stack.size()) return rt_stack[adr - 1 - base];
+		return (adr > base) ? root->heap->at(adr)->load() : shared_cell(adr).load();
+	}
+
+	//get the value at memory address "adr", checking the address
+	//one comparison covers the runtime stack of the machine, only other addresses need the full check
+	template<am1::visibility s> inline bool am1::get(int adr, int& value) const {
+		unsigned int i = adr - 1 + ((s == local) ? ref : 0) - base;
+		if (i < rt_stack.size()) { value = rt_stack[i]; return true; }
+		std::atomic<int>* c = outer_cell<s>(adr);
+		if (!c) return false;
+		value = c->load();
+		return true;
+	}
+
+	//change the value at memory address "adr", checking the address
+	template<am1::visibility s> inline bool am1::set(int adr, int value) {
+		unsigned int i = adr - 1 + ((s == local) ? ref : 0) - base;
+		if (i < rt_stack.size()) { rt_stack[i] = value; return true; }
+		std::atomic<int>* c = outer_cell<s>(adr);
+		if (!c) return false;
+		c->store(value);
+		return true;
+	}
+
+	//memory address "adr" outside of the runtime stack of the machine, in a sealed segment or on the heap
+	//returns nullptr if it isn't valid
+	template<am1::visibility s> std::atomic<int>* am1::outer_cell(int adr) const {
+		unsigned int a = adr + ((s == local) ? ref : 0);
+		if (root->heap && a > heap_arena::base_address) {
+			std::atomic<int>* c = root->heap->at(a);
+			if (!c) std::cerr << "Invalid heap address\n\n";
+			return c;
+		}
+		if (!address_is_valid<s>(adr)) return nullptr;
+		return &shared_cell(a);
+	}
+
+	//memory address "adr" in a sealed segment, the segments cover all addresses up to base
+	std::atomic<int>& am1::shared_cell(unsigned int adr) const {
+		segment* s = sealed.get();
+		while (adr <= s->first) s = s->below.get();
+		return s->cells[adr - 1 - s->first];
+	}
+
+	//read an input value, while tasks are running all machines read through the root one at a time
+	bool am1::task_read(int& i) {
+		if (!root->pool) return read_input(i);
+		std::lock_guard<std::mutex> lock {root->pool->io};
+		if (root != this && root->suspendable) {
+			std::cerr << "A spawned task can't wait for an input value\n\n";
+			return false;
+		}
+		return root->read_input(i);
+	}
+
+	//write an output value, while tasks are running all machines write through the root one at a time
+	void am1::task_write(int i) {
+		if (!root->pool) return write_output(i);
+		std::lock_guard<std::mutex> lock {root->pool->io};
+		root->write_output(i);
+	}
+
 	//check if "jmp_address" is a valid jump address
 	//if "check_loop" is true the jump address can't be equal to the current program counter
 	bool am1::jmp_address_is_valid(int jmp_address, bool check_loop) const {
-		if (jmp_address < 0 || (size_t) jmp_address > prog.size()) {
-			std::cerr << "Invalid jump address. Possible range [0-" + std::to_string(prog.size()) + "]\n\n";
+		//while streaming the jump address may not be parsed yet
+		const auto& prog = root->prog;
+		auto stream = root->stream;
+		size_t size = (stream && jmp_address > 0 && (size_t) jmp_address > prog.size()) ? stream->wait(jmp_address) : prog.size();
+		if (jmp_address < 0 || (size_t) jmp_address > size) {
+			std::cerr << "Invalid jump address. Possible range [0-" + std::to_string(size) + "]\n\n";
 			return false;
 		}
 		if (check_loop && (unsigned int) jmp_address == pc) {
@@ -218,60 +457,229 @@ namespace am1_interpreter {
 		return true;
 	}
 
+	//run the function at program counter, ignoring a breakpoint there
+	bool am1::step_once() {
+		am1_func_visitor afv {*this};
+		resuming = true;
+		bool success = boost::apply_visitor(afv,prog[pc - 1]);
+		resuming = false;
+		if (success) ++steps;
+		return success;
+	}
+
+	//replace lines with breakpoints or writes to watched runtime stack addresses by a trap, restore all other lines
+	void am1::repatch() {
+		watched_lines.clear();
+		for (unsigned int line = 1; line <= prog.size(); ++line) {
+			std::istringstream ls {source[line - 1]};
+			std::string keyword, visible;
+			watched_write w {false, global, 0};
+			ls >> std::ws;
+			if (std::getline(ls,keyword,'(') && !watchpoints.empty()) {
+				if ((keyword == "STOREI" || keyword == "READI") && ls >> w.adr) {
+					w.indirect = true;
+					watched_lines[line] = w;
+				}
+				else if ((keyword == "STORE" || keyword == "READ") && std::getline(ls,visible,',') && ls >> w.adr) {
+					w.v = (visible == "global") ? global : local;
+					//global addresses are constant, so only lines writing to a watched one need a trap
+					if (w.v == local || watchpoints.count(w.adr)) watched_lines[line] = w;
+				}
+			}
+			bool trap_needed = breakpoints.count(line) || watched_lines.count(line);
+			if (trap_needed && !patched.count(line)) {
+				patched[line] = prog[line - 1];
+				prog[line - 1] = trap;
+			}
+			else if (!trap_needed && patched.count(line)) {
+				prog[line - 1] = patched[line];
+				patched.erase(line);
+			}
+		}
+	}
+
+	//publish the current statistics
+	//the memory of AM1 is the runtime stack and the heap
+	void am1::publish_stats() const {
+		publish_counters(base + rt_stack.size(), base + rt_stack.size() + (heap ? heap->used() : 0));
+	}
+
+	//append the complete state of the machine including the heap
+	//while spawned tasks are running, the state of the machine alone doesn't determine its future
+	bool am1::snapshot(std::vector<int>& s) const {
+		if (!children.empty()) return false;
+		s.push_back(pc);
+		s.push_back(ref);
+		s.push_back(d_stack.size());
+		s.insert(s.end(), d_stack.begin(), d_stack.end());
+		s.push_back(rt_stack.size());
+		s.insert(s.end(), rt_stack.begin(), rt_stack.end());
+		if (heap) heap->snapshot(s);
+		return true;
+	}
+
+	//record the state of the machine, it is interrupted by the signal, so nothing may be allocated or locked
+	//the return addresses are found by following the previous refs, the cells are copied by the kernel as
+	//the runtime stack may be reallocated at the moment
+	void am1::take_sample(am0_interpreter::sample& s) const {
+		s.pc = running_line();
+		s.ref = ref;
+		s.depth = 0;
+		const int* cells = rt_stack.data();
+		size_t size = rt_stack.size();
+		unsigned int r = ref;
+		int frame[2];
+		while (s.depth < am0_interpreter::sample::max_depth && r >= base + 2 && r - base <= size &&
+			am0_interpreter::sampler::read_cells(cells + (r - base - 2), frame, 2)) {
+			//the previous ref has to be below, otherwise the frame is just being built
+			if (frame[0] <= 0 || frame[1] < 0 || (unsigned int) frame[1] >= r) break;
+			s.ra[s.depth++] = frame[0];
+			r = frame[1];
+		}
+	}
+
+	//report the procedures the most samples were taken in, by itself and including the procedures called by them
+	//the procedure of a frame is the target of the CALL before its return address
+	void am1::write_sampled_procedures(std::ostream& os, const std::vector<am0_interpreter::sample>& samples) const {
+		auto target = [this] (unsigned int ra) {
+			std::istringstream ls {(ra > 1 && ra - 1 <= source.size()) ? source[ra - 2] : ""};
+			std::string keyword;
+			unsigned int t = 0;
+			return (ls >> keyword && keyword == "CALL" && ls >> t) ? t : 0;
+		};
+		std::map<unsigned int,std::pair<unsigned long,unsigned long>> procedures;
+		for (auto& s : samples) {
+			if (!s.pc) continue;
+			std::set<unsigned int> entries;
+			for (unsigned int i = 0; i < s.depth; ++i) entries.insert(target(s.ra[i]));
+			//the program itself is only known to be at the bottom if the walk reached it
+			if (s.depth < am0_interpreter::sample::max_depth) entries.insert(1);
+			++procedures[s.depth ? target(s.ra[0]) : 1].first;
+			for (auto e : entries) ++procedures[e].second;
+		}
+		std::vector<std::pair<std::pair<unsigned long,unsigned long>,unsigned int>> hot;
+		for (auto& p : procedures) hot.push_back({p.second, p.first});
+		std::stable_sort(hot.begin(), hot.end(), [] (const std::pair<std::pair<unsigned long,unsigned long>,unsigned int>& a,
+			const std::pair<std::pair<unsigned long,unsigned long>,unsigned int>& b) { return a.first.first > b.first.first; });
+		if (hot.size() > hot_entries) hot.resize(hot_entries);
+		os << "Hot procedures:\n" << std::setw(8) << "SELF" << std::setw(8) << "TOTAL" << "  PROCEDURE\n";
+		for (auto& p : hot) {
+			os << std::fixed << std::setprecision(1) << std::setw(7) << 100.0 * p.first.first / samples.size() << "%" <<
+				std::setw(7) << 100.0 * p.first.second / samples.size() << "%  " <<
+				(p.second ? procedure_name(p.second) + " (line " + std::to_string(p.second) + ")" : "unknown") << "\n";
+		}
+	}
+
+	//write bounds of the instructions and the depths of both stacks for every procedure
+	void am1::analyze(std::ostream& os) const {
+		am0_interpreter::write_analysis(os, source, true);
+	}
+
+	//code rebuilding the current state for a residual program
+	//"writes" are the values written so far, they are written again at the beginning
+	std::vector<am0_interpreter::residual_line> am1::residual_prologue(const std::vector<int>& writes,
+		std::vector<unsigned int>& roots) const {
+		std::vector<am0_interpreter::residual_line> p;
+		//written values are passed to a procedure at line 2, which writes and removes its argument
+		if (!writes.empty()) {
+			p.push_back({"JMP 4;", -1});
+			p.push_back({"WRITE(local,-2);", -1});
+			p.push_back({"RET 1;", -1});
+		}
+		for (int v : writes) {
+			p.push_back({"LIT " + std::to_string(v) + ";", -1});
+			p.push_back({"PUSH;", -1});
+			p.push_back({"CALL 2;", -1});
+		}
+		//return addresses of all activation records are code lines, which have to be relocated
+		std::vector<bool> ra(rt_stack.size(), false);
+		for (unsigned int r = ref; r >= 2 && r <= rt_stack.size(); r = rt_stack[r - 1]) {
+			ra[r - 2] = true;
+			roots.push_back(rt_stack[r - 2]);
+			if ((unsigned int) rt_stack[r - 1] >= r) break;
+		}
+		auto push_cell = [&] (size_t i) {
+			if (ra[i]) p.push_back({"LIT ", rt_stack[i]});
+			else p.push_back({"LIT " + std::to_string(rt_stack[i]) + ";", -1});
+			p.push_back({"PUSH;", -1});
+		};
+		size_t i = 0;
+		if (ref >= 2 && ref <= rt_stack.size()) {
+			for (; i < ref - 2; ++i) push_cell(i);
+			//CALL sets ref, afterwards its return address and previous activation record are overwritten
+			p.push_back({"CALL " + std::to_string(p.size() + 2) + ";", -1});
+			p.push_back({"LIT ", rt_stack[ref - 2]});
+			p.push_back({"STORE(local,-1);", -1});
+			p.push_back({"LIT " + std::to_string(rt_stack[ref - 1]) + ";", -1});
+			p.push_back({"STORE(local,0);", -1});
+			i = ref;
+		}
+		for (; i < rt_stack.size(); ++i) push_cell(i);
+		for (int v : d_stack) p.push_back({"LIT " + std::to_string(v) + ";", -1});
+		p.push_back({"JMP ", (int) pc});
+		return p;
+	}
+
+	//print out the state of the machine
+	void am1::print_state(std::ostream& os) const {
+		os << *this;
+	}
+
 	//prints out the state of the machine
 	std::ostream& operator<<(std::ostream& os, const am1& o) {
 		std::string ret = "(" + std::to_string(o.pc);
 		//offset for the program counter (maximum character space needed is known at this point)
-		for (size_t i=0; i < (std::to_string(o.prog.size()).length() - ret.length() + 1);++i) ret += ' ';
+		for (size_t i=0; i < (std::to_string(o.root->prog.size()).length() - ret.length() + 1);++i) ret += ' ';
 		ret += " , ";
 		//print data stack in reverse order
 		for (auto rit = o.d_stack.rbegin(); rit != o.d_stack.rend(); ++rit) ret += std::to_string(*rit) + ":";
 		if (o.d_stack.size()) ret.pop_back();
 		else ret += "-";
 		ret += " , ";
-		for (auto x : o.rt_stack ) ret += std::to_string(x) + ":";
-		if (o.rt_stack.size()) ret.pop_back();
+		//a spawned task prints the cells of the tasks it was spawned by, too
+		for (unsigned int i = 1; i <= o.base + o.rt_stack.size(); ++i) ret += std::to_string(o.cell(i)) + ":";
+		if (o.base + o.rt_stack.size()) ret.pop_back();
 		else ret += "-";
 		ret += " , " + std::to_string(o.ref) + ")";
 		return os << ret;
 	}
 
 	//applicators to functions in the program code container{
-	bool am1::am1_func_visitor::operator()(std::function<bool(am0&)>& f) {
+	bool am1::am1_func_visitor::operator()(bool(*f)(am0&)) {
 		return f(this->am1_machine);
 	}
 
-	bool am1::am1_func_visitor::operator()(std::pair<std::function<bool(am0&,int)>, int>& fc) {
+	bool am1::am1_func_visitor::operator()(std::pair<bool(*)(am0&,int), int>& fc) {
 		return fc.first(this->am1_machine,fc.second);
 	}
 
-	bool am1::am1_func_visitor::operator()(std::function<bool(am1&)>& f) {
+	bool am1::am1_func_visitor::operator()(bool(*f)(am1&)) {
 		return f(this->am1_machine);
 	}
 
-	bool am1::am1_func_visitor::operator()(std::pair<std::function<bool(am1&,int)>,int>& fc) {
+	bool am1::am1_func_visitor::operator()(std::pair<bool(*)(am1&,int),int>& fc) {
 		return fc.first(this->am1_machine,fc.second);
 	}
 
-	bool am1::am1_func_visitor::operator()(std::tuple<std::function<bool(am1&,visibility,int)>,visibility,int>& fc) {
-		return (std::get<0>(fc))(this->am1_machine,std::get<1>(fc),std::get<2>(fc));
+	bool am1::am1_func_visitor::operator()(std::tuple<bool(*)(am1&,int,int),int,int>& fc) {
+		return std::get<0>(fc)(this->am1_machine,std::get<1>(fc),std::get<2>(fc));
 	}
 	//}
 
 	//operation: LOAD(b,o)
-	bool am1::load(am1& a, visibility s, int adr) {
-		if (!a.address_is_valid(s,adr)) return false;
+	template<am1::visibility s> bool am1::load(am1& a, int adr) {
+		int value;
+		if (!a.get<s>(adr, value)) return false;
 		//load value at memory address from runtime stack to data stack
-		a.d_stack.push_back(a.rt_stack[adr - 1 + ((s == local) ? a.ref : 0)]);
+		a.d_stack.push_back(value);
 		a.pc++;
 		return true;
 	}
 
 	//operation: STORE(b,o)
-	bool am1::store(am1& a, visibility s, int adr) {
-		if (!a.enough_arguments_on_stack(1) || !a.address_is_valid(s,adr)) return false;
+	template<am1::visibility s> bool am1::store(am1& a, int adr) {
 		//store value from data stack at memory address on runtime stack
-		a.rt_stack[adr - 1 + ((s == local) ? a.ref : 0)] = a.d_stack.back();
+		if (!a.enough_arguments_on_stack(1) || !a.set<s>(adr, a.d_stack.back())) return false;
 		//remove value from data stack
 		a.d_stack.pop_back();
 		a.pc++;
@@ -279,60 +687,82 @@ namespace am1_interpreter {
 	}
 
 	//operation: READ(b,o)
-	bool am1::read(am1& a, visibility s, int adr) {
-		if (!a.address_is_valid(s,adr)) return false;
+	template<am1::visibility s> bool am1::read(am1& a, int adr) {
+		//the address is checked like by set before the value is read, so an invalid one doesn't consume it
+		unsigned int c = adr - 1 + ((s == local) ? a.ref : 0) - a.base;
+		if (c >= a.rt_stack.size() && !a.outer_cell<s>(adr)) return false;
 		int i;
-		//get value from stdin and store this value at memory address on runtime stack
-		std::cout << " In: "; std::cin >> i;
-		if (std::cin.fail()) { std::cin.clear(); std::cerr << "Wrong input\n\n"; return false; }
-		a.rt_stack[adr - 1 + ((s == local) ? a.ref : 0)] = i;
+		//get value from stdin and store this value at memory address on runtime stack or heap
+		if (!a.task_read(i)) return false;
+		a.set<s>(adr, i);
 		a.pc++;
 		return true;
 	}
 
 	//operation: WRITE(b,o)
-	bool am1::write(am1& a, visibility s, int adr) {
-		if (!a.address_is_valid(s,adr)) return false;
+	template<am1::visibility s> bool am1::write(am1& a, int adr) {
+		int value;
+		if (!a.get<s>(adr, value)) return false;
 		//write value at memory address from runtime stack to stdout
-		std::cout << "Out: " << a.rt_stack[adr - 1 + ((s == local) ? a.ref : 0)] << std::endl;
+		a.task_write(value);
+		a.pc++;
+		return true;
+	}
+
+	//operation: LOADA(b,o)
+	template<am1::visibility s> bool am1::loada(am1& a, int adr) {
+		if (!a.address_is_valid<s>(adr)) return false;
+		//load relative address to data stack
+		a.d_stack.push_back(adr + ((s == local) ? a.ref : 0));
 		a.pc++;
 		return true;
 	}
 
-	//operation: LOADI(o)
-	bool am1::loadi(am1& a, int adr) {
-		if (!a.address_is_valid(local,adr)) return false;
-		//dereference address and call LOAD(global,*o)
-		return am1::load(a,global,a.rt_stack[adr - 1 + a.ref]);
+	//operation: LOADI(o), STOREI(o), READI(o) and WRITEI(o)
+	//"f" is the direct operation with global visibility, it gets inlined into every indirect operation
+	template<bool(*f)(am1&,int)> bool am1::indirect(am1& a, int adr) {
+		int p;
+		if (!a.get<local>(adr, p)) return false;
+		//dereference address and call f(global,*o)
+		return f(a,p);
 	}
 
-	//operation: STOREI(o)
-	bool am1::storei(am1& a, int adr) {
-		if (!a.address_is_valid(local,adr)) return false;
-		//dereference address and call STORE(global,*o)
-		return am1::store(a,global,a.rt_stack[adr - 1 + a.ref]);
+	//operation: JMP e
+	//same as in AM0, but the jump address check of AM1 is called without a virtual call
+	bool am1::jmp(am1& a, int par) {
+		if (!a.jmp_address_is_valid(par, true)) return false;
+		//change the program counter to jump address
+		a.pc = par;
+		return true;
 	}
 
-	//operation: READI(o)
-	bool am1::readi(am1& a, int adr) {
-		if (!a.address_is_valid(local,adr)) return false;
-		//dereference address and call READ(global,*o)
-		return am1::read(a,global,a.rt_stack[adr - 1 + a.ref]);
+	//operation: JMP e with tiered execution
+	//tasks count their own backward jumps and compile their own loops from the code of the root
+	bool am1::counted_jmp(am1& a, int par) {
+		unsigned int from = a.pc;
+		if (!jmp(a, par)) return false;
+		if (a.pc && a.pc < from) a.tier_up(from, a.root->source);
+		return true;
 	}
 
-	//operation: WRITEI(o)
-	bool am1::writei(am1& a, int adr) {
-		if (!a.address_is_valid(local,adr)) return false;
-		//dereference address and call WRITE(global,*o)
-		return am1::write(a,global,a.rt_stack[adr - 1 + a.ref]);
+	//operation: JMC e
+	bool am1::jmc(am1& a, int par) {
+		if (!a.jmp_address_is_valid(par) || !a.enough_arguments_on_stack(1)) return false;
+		//if the value at the end of the data stack is 0 pc will be changed to jump address
+		if (a.d_stack.back() == 0) a.pc = par;
+		//if the value at the end of the data stack is 1 pc will increased normaly
+		else if (a.d_stack.back() == 1) ++a.pc;
+		else { std::cerr << "Jump conditions have to be 1 or 0\n\n"; return false; }
+		//remove the value at the end of the data stack
+		a.d_stack.pop_back();
+		return true;
 	}
 
-	//operation: LOADA(b,o)
-	bool am1::loada(am1& a, visibility s, int adr) {
-		if (!a.address_is_valid(s,adr)) return false;
-		//load relative address to data stack
-		a.d_stack.push_back(adr + ((s == local) ? a.ref : 0));
-		a.pc++;
+	//operation: JMC e with tiered execution, counted like JMP if it jumps back
+	bool am1::counted_jmc(am1& a, int par) {
+		unsigned int from = a.pc;
+		if (!jmc(a, par)) return false;
+		if (a.pc && a.pc < from) a.tier_up(from, a.root->source);
 		return true;
 	}
 
@@ -357,7 +787,8 @@ namespace am1_interpreter {
 		//update program counter
 		a.pc = adr;
 		//update ref to new point of the last previous activation record
-		a.ref = a.rt_stack.size();
+		a.ref = a.base + a.rt_stack.size();
+		if (a.profiler) a.profiler->enter(adr, a.steps + 1);
 		return true;
 	}
 
@@ -377,29 +808,149 @@ namespace am1_interpreter {
 
 	//operation: RET n
 	bool am1::ret(am1& a, int par) {
+		//a procedure can't return while tasks it spawned are running
+		if (!a.children.empty() && !a.join_children()) return false;
 		if (par < 0 || a.rt_stack.size() < (size_t) (par + 2)) {
 			std::cerr << "Not enough values on runtime stack\n\n";
 			return false;
 		}
-		if (a.ref > a.rt_stack.size()) {
+		if (a.ref > a.base + a.rt_stack.size() || a.ref < a.base + par + 2) {
 			std::cerr << "Invalid ref. Not enough values on runtime stack\n\n";
 			return false;
 		}
-		if (!a.ra_address_is_valid(a.rt_stack[a.ref - 2]) ||
-			a.rt_stack[a.ref - 1] > ((int) a.ref - 2) || a.rt_stack[a.ref - 1] < 0) {
+		//relative to the runtime stack, the cells below base belong to other tasks
+		unsigned int r = a.ref - a.base;
+		//a spawned task ends by returning to line 0
+		if ((a.rt_stack[r - 2] || !a.parent) && !a.ra_address_is_valid(a.rt_stack[r - 2])) {
+			std::cerr << "Can't return. Invalid arguments on runtime stack\n\n";
+			return false;
+		}
+		if (a.rt_stack[r - 1] > ((int) a.ref - 2) || a.rt_stack[r - 1] < 0) {
 			std::cerr << "Can't return. Invalid arguments on runtime stack\n\n";
 			return false;
 		}
 		//return old program counter
-		a.pc = a.rt_stack[a.ref - 2];
+		a.pc = a.rt_stack[r - 2];
 		//save a temporary backup of the old ref
-		unsigned int oldref = a.ref;
+		unsigned int oldref = r;
 		//return previous activation record to ref
-		a.ref = a.rt_stack[a.ref - 1];
+		a.ref = a.rt_stack[r - 1];
 		//remove localy initialised values from runtime stack
 		while (a.rt_stack.size() > oldref) a.rt_stack.pop_back();
 		//remove n local parameters, the return address and the previous activation record from runtime stack
 		for (int i = 0; i < (par + 2); ++i) a.rt_stack.pop_back();
+		if (a.profiler) a.profiler->leave(a.steps + 1);
 		return true;
 	}
+
+	//operation: SPAWN adr,n
+	//like CALL, but the procedure runs as a task of its own, which gets the n arguments on top of the runtime stack
+	//the cells below them are sealed and shared with the task until the next JOIN
+	bool am1::spawn(am1& a, int adr, int n) {
+		if (!a.ra_address_is_valid(adr)) return false;
+		if (n < 0 || a.rt_stack.size() < (size_t) n) {
+			std::cerr << "Not enough values on runtime stack\n\n";
+			return false;
+		}
+		if (!a.root->pool) a.root->pool.reset(new task_pool(a.root->workers));
+		size_t rest = a.rt_stack.size() - n;
+		if (rest) {
+			a.sealed = std::make_shared<segment>(a.base, rest, a.sealed);
+			for (size_t i = 0; i < rest; ++i) a.sealed->cells[i].store(a.rt_stack[i], std::memory_order_relaxed);
+			++a.owned;
+		}
+		am1* t = new am1;
+		a.children.emplace_back(t);
+		t->root = a.root;
+		t->parent = &a;
+		t->base = a.base + rest;
+		t->sealed = a.sealed;
+		t->rt_stack.assign(a.rt_stack.begin() + rest, a.rt_stack.end());
+		//return address 0 ends the task, the previous activation record is never used
+		t->rt_stack.push_back(0);
+		t->rt_stack.push_back(0);
+		t->ref = t->base + t->rt_stack.size();
+		t->pc = adr;
+		a.rt_stack.clear();
+		a.base = t->base;
+		a.pending.fetch_add(1, std::memory_order_relaxed);
+		a.root->pool->submit([t] () {
+			t->task_succeeded = t->run_task();
+			t->parent->pending.fetch_sub(1, std::memory_order_release);
+		});
+		a.pc++;
+		return true;
+	}
+
+	//operation: JOIN
+	//wait for all tasks spawned by this procedure, afterwards their writes to shared cells are visible
+	bool am1::join(am1& a) {
+		if (!a.join_children()) return false;
+		a.pc++;
+		return true;
+	}
+
+	//operation: ALLOC
+	bool am1::alloc(am1& a) {
+		if (!a.enough_arguments_on_stack(1)) return false;
+		if (!a.root->heap) {
+			std::cerr << "No heap, it has to be enabled by --heap\n\n";
+			return false;
+		}
+		if (a.d_stack.back() <= 0) {
+			std::cerr << "Alloc only takes sizes > 0\n\n";
+			return false;
+		}
+		//replace the size at the end of the data stack by the address of a new block
+		unsigned int adr = a.root->heap->alloc(a.d_stack.back());
+		if (!adr) {
+			std::cerr << "Out of heap memory\n\n";
+			return false;
+		}
+		a.d_stack.back() = adr;
+		a.pc++;
+		return true;
+	}
+
+	//operation: FREE
+	bool am1::dealloc(am1& a) {
+		if (!a.enough_arguments_on_stack(1)) return false;
+		//free the block at the address at the end of the data stack
+		if (!a.root->heap || !a.root->heap->free(a.d_stack.back())) {
+			std::cerr << "Invalid heap address. No block starts there\n\n";
+			return false;
+		}
+		a.d_stack.pop_back();
+		a.pc++;
+		return true;
+	}
+
+	//operation: trap of the debugger
+	bool am1::trap(am1& a) {
+		unsigned int line = a.pc;
+		//spawned tasks run the original lines of the root
+		if (a.root != &a) {
+			am1_func_visitor afv {a};
+			return boost::apply_visitor(afv,a.root->patched[line]);
+		}
+		//breakpoint: stop before running the original line
+		if (!a.resuming && a.breakpoints.count(line)) { a.trapped = break_trap; return false; }
+		a.resuming = false;
+		am1_func_visitor afv {a};
+		auto w = a.watched_lines.find(line);
+		if (w == a.watched_lines.end()) return boost::apply_visitor(afv,a.patched[line]);
+		//watchpoint: compute the written address, run the original line and stop afterwards if it is watched
+		size_t size = a.base + a.rt_stack.size();
+		int adr = w->second.adr + ((w->second.v == local || w->second.indirect) ? a.ref : 0);
+		if (w->second.indirect) adr = (adr > 0 && (size_t) adr <= size) ? a.cell(adr) : 0;
+		if (!a.watchpoints.count(adr)) return boost::apply_visitor(afv,a.patched[line]);
+		std::string old = (adr > 0 && (size_t) adr <= size) ? std::to_string(a.cell(adr)) : "-";
+		if (!boost::apply_visitor(afv,a.patched[line])) return false;
+		a.watch_note = "[" + std::to_string(adr) + "]: " + old + " -> " + std::to_string(a.cell(adr)) +
+			" at line " + std::to_string(line);
+		a.trapped = watch_trap;
+		//the original line has been run, even though the machine stops
+		++a.steps;
+		return false;
+	}
 }
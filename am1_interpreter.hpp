@@ -1,50 +1,145 @@
+#include <memory>
+#include <tuple>
+#include <atomic>
 #include "am0_interpreter.hpp"
+#include "task_pool.hpp"
+#include "heap_arena.hpp"
+#include "call_profiler.hpp"
 
 namespace am1_interpreter {
 	class am1 : private am0_interpreter::am0 {
 		public:
 			bool run(bool = false) final override; //starts the machine
+			bool run_streaming(std::istream& = std::cin, bool = false, bool = false) final override; //parse and run at once
 			void reset(void) final override; //sets the machine to default
 			bool parse_prog(std::istream& = std::cin, bool = false) final override; //parse code into the machine
 			bool parse_state(std::istream& = std::cin) final override; //parse a initial state into the machine
+			using am0::debug; //run the machine under the interactive debugger
+			using am0::record; //record all values read by the machine into a log
+			using am0::replay; //read all values from a recorded log instead of stdin
+			using am0::fast_forward; //run without any output up to a given step
+			using am0::run_state; //reason for resume to return
+			using am0::resume; //run until the machine halts, fails or waits for an input value
+			using am0::supply; //provide the input value a suspended READ waits for
+			using am0::on_output; //deliver the values of WRITE to a callback
+			using am0::attach_stats; //publish statistics while running
+			using am0::specialize; //partial evaluation for known input values
+			using am0::start_sampling; //sample the machine every given microseconds of CPU time
+			using am0::write_samples; //stop sampling and report the hot lines and procedures
+			using am0::detect_loops; //stop the machine if its state repeats without reading a value
+			void tiered(void) final override; //run hot loops from compiled code
+			void analyze(std::ostream& = std::cout) const final override; //estimate the costs without running
+			void parallel(unsigned int); //run spawned tasks on the given number of worker threads
+			void enable_heap(unsigned int); //give the machine a heap of the given number of cells
+			void profile(void); //profile the procedures called from now on
+			void write_profile(std::ostream&, std::ostream&); //write the call profile and the collapsed call stacks
 			friend std::ostream& operator<<(std::ostream&,const am1&); //print out the state of the machine
 		private:
 			enum visibility {local, global}; //information if address should be interpreted relative to ref
+			//the visibility is a template parameter of the memory operations, so no handler needs it at runtime
 			typedef boost::variant<
-				std::function<bool(am0&)>,
-				std::pair<std::function<bool(am0&,int)>,int>,
-				std::function<bool(am1&)>,
-				std::pair<std::function<bool(am1&,int)>,int>,
-				std::tuple<std::function<bool(am1&,visibility,int)>, visibility, int>
+				bool(*)(am0&),
+				std::pair<bool(*)(am0&,int),int>,
+				bool(*)(am1&),
+				std::pair<bool(*)(am1&,int),int>,
+				std::tuple<bool(*)(am1&,int,int),int,int>
 			> am1_func;
 
 			std::vector<am1_func> prog; //program code container
 			std::vector<int> rt_stack; //runtime stack
 			unsigned int ref = 0; //point of the last "previous activation record"
+			am0_interpreter::prog_stream<am1_func>* stream = nullptr; //instructions of the parsing thread while streaming
+
+			//parallel tasks {
+			//every task is a machine of its own with a cactus stack: the cells below "base" belong to the tasks
+			//it was spawned by and are sealed into segments, which are shared and accessed atomically
+			struct segment {
+				unsigned int first; //cells[0] is at address first + 1
+				std::vector<std::atomic<int>> cells;
+				std::shared_ptr<segment> below;
+				segment(unsigned int f, size_t n, std::shared_ptr<segment> b) : first(f), cells(n), below(b) {}
+			};
+			am1* root = this; //machine which started the program, it owns the code and the pool
+			am1* parent = nullptr; //machine which spawned this task
+			unsigned int base = 0; //addresses up to base are in sealed segments, rt_stack holds the cells above
+			std::shared_ptr<segment> sealed; //topmost sealed segment
+			unsigned int owned = 0; //segments on top sealed by this machine, they are unsealed again by JOIN
+			std::vector<std::unique_ptr<am1>> children; //tasks spawned since the last JOIN
+			std::atomic<unsigned int> pending {0}; //children not finished yet
+			bool task_succeeded = false;
+			unsigned int workers = 1;
+			std::unique_ptr<task_pool> pool; //only used by the root
+			//}
+			std::unique_ptr<heap_arena> heap; //heap of ALLOC and FREE, only used by the root
+			std::unique_ptr<call_profiler> profiler; //shadow call stack, only used by the root
+			std::map<unsigned int,std::string> comments; //first line of the comment block before a code line
+
+			//write to the runtime stack by STORE, READ, STOREI or READI, watched by the debugger
+			struct watched_write {
+				bool indirect;
+				visibility v;
+				int adr;
+			};
+			std::map<unsigned int,am1_func> patched; //original functions of the lines replaced by a trap
+			std::map<unsigned int,watched_write> watched_lines; //lines which may write to a watched address
+
+			void emit(const am1_func&); //add a parsed function to the program code container
+			bool step_once(void) final override; //run the function at program counter, ignoring a breakpoint there
+			void repatch(void) final override; //replace lines with breakpoints or watched writes by a trap
+			void print_state(std::ostream&) const final override; //print out the state of the machine
+			void publish_stats(void) const final override; //publish the current statistics
+			void take_sample(am0_interpreter::sample&) const final override; //record the state and the return addresses
+			bool snapshot(std::vector<int>&) const final override; //append the complete state of the machine
+			int* compiled_cell(bool, int) final override; //cell of a compiled loop on the runtime stack of the machine
+			int compiled_frame(void) const final override { return ref; } //added to the local addresses of LOADA
+			//report the procedures the most samples were taken in
+			void write_sampled_procedures(std::ostream&, const std::vector<am0_interpreter::sample>&) const final override;
+			bool finish_tasks(void) final override { return join_children(); } //finish the parked tasks
+			//code rebuilding the current state for a residual program
+			std::vector<am0_interpreter::residual_line> residual_prologue(const std::vector<int>&,
+				std::vector<unsigned int>&) const final override;
 
 
 			class am1_func_visitor : public boost::static_visitor<bool> {
 				public:
 					am1_func_visitor(am1& a) : am1_machine(a) {}
-					bool operator()(std::function<bool(am0&)>&);
-					bool operator()(std::pair<std::function<bool(am0&,int)>,int>&);
-					bool operator()(std::function<bool(am1&)>&);
-					bool operator()(std::pair<std::function<bool(am1&,int)>,int>&);
-					bool operator()(std::tuple<std::function<bool(am1&,visibility,int)>,visibility,int>&);
+					bool operator()(bool(*)(am0&));
+					bool operator()(std::pair<bool(*)(am0&,int),int>&);
+					bool operator()(bool(*)(am1&));
+					bool operator()(std::pair<bool(*)(am1&,int),int>&);
+					bool operator()(std::tuple<bool(*)(am1&,int,int),int,int>&);
 				private:
 					am1& am1_machine;
 			};
 
-			bool address_is_valid(visibility, int) const; //check if a memory address is valid
+			bool run_task(void); //run a spawned task until its procedure returns
+			bool join_children(void); //wait for all children and unseal the own segments
+			int cell(unsigned int) const; //value at an absolute memory address
+			template<visibility> bool get(int, int&) const; //get the value at a memory address
+			template<visibility> bool set(int, int); //change the value at a memory address
+			std::atomic<int>& shared_cell(unsigned int) const; //memory address in a sealed segment
+			//memory address outside of the runtime stack of the machine
+			template<visibility> std::atomic<int>* outer_cell(int) const;
+			bool task_read(int&); //read an input value, tasks read through the root
+			void task_write(int); //write an output value, tasks write through the root
+			std::string procedure_name(unsigned int) const; //name of the procedure at a line for the profile
+
+			template<visibility> bool address_is_valid(int) const; //check if a memory address is valid
 			bool ra_address_is_valid(int) const; //check if a return address is valid
 			bool jmp_address_is_valid(int,bool = false) const final override; //check if a jump address is valid
 
-			static bool load(am1&,visibility,int), store(am1&,visibility,int);
-		   	static bool read(am1&,visibility,int), write(am1&,visibility,int);
-			static bool loadi(am1&,int), storei(am1&,int);
-			static bool readi(am1&,int), writei(am1&,int);
-			static bool loada(am1&,visibility,int);
+			template<visibility> static bool load(am1&,int);
+			template<visibility> static bool store(am1&,int);
+			template<visibility> static bool read(am1&,int);
+			template<visibility> static bool write(am1&,int);
+			template<visibility> static bool loada(am1&,int);
+			template<bool(*)(am1&,int)> static bool indirect(am1&,int);
+			static bool jmp(am1&,int), jmc(am1&,int);
+			static bool counted_jmp(am1&,int), counted_jmc(am1&,int);
 			static bool push(am1&);
 			static bool call(am1&,int), init(am1&,int), ret(am1&,int);
+			static bool spawn(am1&,int,int), join(am1&);
+			static bool alloc(am1&), dealloc(am1&);
+			static bool trap(am1&);
 	};
 }
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <map>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <cerrno>
+#include <dirent.h>
+#include <signal.h>
+#include "shm_stats.hpp"
+#define __PROG_NAME__ "amstat"
+
+using namespace am0_interpreter;
+using namespace std;
+
+//copy of the statistics of one machine
+struct snapshot {
+	string machine, program;
+	bool running;
+	uint64_t steps, pc, d_stack, rt_stack, memory, reads, writes, start_ns, update_ns;
+};
+
+//read the statistics of all live machines
+map<int,snapshot> collect() {
+	map<int,snapshot> machines;
+	DIR* dir = opendir("/dev/shm");
+	if (!dir) return machines;
+	while (dirent* e = readdir(dir)) {
+		string name = e->d_name;
+		if (name.compare(0, 7, "amstat.")) continue;
+		shm_stats_segment segment;
+		if (!segment.open("/" + name)) continue;
+		const shm_stats* s = segment.get();
+		//segments of crashed processes are left behind
+		if (kill(s->pid, 0) && errno != EPERM) continue;
+		snapshot& m = machines[s->pid];
+		m.machine = string(s->machine, sizeof(s->machine)).c_str();
+		m.program = string(s->program, sizeof(s->program)).c_str();
+		m.running = s->running.load(memory_order_relaxed);
+		m.steps = s->steps.load(memory_order_relaxed);
+		m.pc = s->pc.load(memory_order_relaxed);
+		m.d_stack = s->d_stack.load(memory_order_relaxed);
+		m.rt_stack = s->rt_stack.load(memory_order_relaxed);
+		m.memory = s->memory.load(memory_order_relaxed);
+		m.reads = s->reads.load(memory_order_relaxed);
+		m.writes = s->writes.load(memory_order_relaxed);
+		m.start_ns = s->start_ns.load(memory_order_relaxed);
+		m.update_ns = s->update_ns.load(memory_order_relaxed);
+	}
+	closedir(dir);
+	return machines;
+}
+
+//print the statistics of all machines
+//instructions per second are measured since the last refresh, or since the start of the machine
+void print(const map<int,snapshot>& machines, const map<int,snapshot>& last) {
+	cout << left << setw(8) << "PID" << setw(5) << "AM" << setw(6) << "STATE" << right <<
+		setw(14) << "STEPS" << setw(8) << "PC" << setw(9) << "D_STACK" << setw(10) << "RT_STACK" <<
+		setw(10) << "MEMORY" << setw(8) << "READS" << setw(8) << "WRITES" << setw(12) << "IPS" << "  PROGRAM\n";
+	for (auto& x : machines) {
+		const snapshot& m = x.second;
+		auto l = last.find(x.first);
+		double ips = 0;
+		if (l != last.end() && m.update_ns > l->second.update_ns)
+			ips = (m.steps - l->second.steps) * 1e9 / (m.update_ns - l->second.update_ns);
+		else if (l == last.end() && m.update_ns > m.start_ns)
+			ips = m.steps * 1e9 / (m.update_ns - m.start_ns);
+		cout << left << setw(8) << x.first << setw(5) << m.machine << setw(6) << (m.running ? "run" : "done") << right <<
+			setw(14) << m.steps << setw(8) << m.pc << setw(9) << m.d_stack << setw(10) << m.rt_stack <<
+			setw(10) << m.memory << setw(8) << m.reads << setw(8) << m.writes <<
+			setw(12) << fixed << setprecision(0) << ips << "  " << m.program << "\n";
+	}
+	cout << flush;
+}
+
+int main(int argc, char** argv) {
+	bool watch = false;
+	//map parameters to options
+	map<string,function<void()>> options = {
+		//refresh the statistics every second
+		{"-w", ([&] () {watch= true;})},
+		{"--watch", ([&] () {watch= true;})}
+	};
+	if (argc == 2 && (string {"--help"} == argv[1])) {
+		cout << "Call: amstat [OPTIONS]\nShows the statistics of all running AM0 and AM1 interpreters\n" <<
+			"started with --stats.\n\n" <<
+			"Options:\n" <<
+			"  -w, --watch\t\tRefresh the statistics every second\n";
+		return 1;
+	}
+	for (int i = 1; i < argc; ++i) {
+		if (options.count(argv[i])) options[argv[i]]();
+		else {
+			cerr << __PROG_NAME__ << ": Invalid option '" << argv[i] << "'" << endl <<
+				"\"amstat --help\" gives further information." << endl;
+			return 1;
+		}
+	}
+	map<int,snapshot> last;
+	do {
+		map<int,snapshot> machines = collect();
+		//clear the screen before every refresh
+		if (watch) cout << "\x1b[H\x1b[2J";
+		print(machines, last);
+		last = machines;
+		if (watch) this_thread::sleep_for(chrono::seconds(1));
+	} while (watch);
+	return 0;
+}
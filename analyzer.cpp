@@ -0,0 +1,622 @@
+#include <map>
+#include <set>
+#include <cstdlib>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+#include "analyzer.hpp"
+
+namespace am0_interpreter {
+	namespace {
+		//upper bound as a polynomial in the values of memory cells, which are assumed to be non-negative
+		//every term maps its sorted factors to its coefficient, the constant term has no factors
+		struct bound {
+			bool unbounded = false;
+			std::string why; //reason if there is no bound
+			std::map<std::vector<std::string>,long long> terms;
+			bound(long long c = 0) { if (c) terms[{}] = c; }
+			explicit bound(const std::string& cell) { terms[{cell}] = 1; }
+			static bound none(const std::string& reason) {
+				bound b;
+				b.unbounded = true;
+				b.why = reason;
+				return b;
+			}
+			long long value() const { auto t = terms.find({}); return (t == terms.end()) ? 0 : t->second; }
+		};
+
+		bound operator+(const bound& a, const bound& b) {
+			if (a.unbounded) return a;
+			if (b.unbounded) return b;
+			bound r = a;
+			for (auto& t : b.terms) r.terms[t.first] += t.second;
+			return r;
+		}
+
+		bound operator*(const bound& a, const bound& b) {
+			if (a.unbounded) return a;
+			if (b.unbounded) return b;
+			bound r;
+			for (auto& x : a.terms) for (auto& y : b.terms) {
+				std::vector<std::string> f = x.first;
+				f.insert(f.end(), y.first.begin(), y.first.end());
+				std::sort(f.begin(), f.end());
+				if (x.second && y.second) r.terms[f] += x.second * y.second;
+			}
+			return r;
+		}
+
+		//bound of both, term by term
+		bound max(const bound& a, const bound& b) {
+			if (a.unbounded) return a;
+			if (b.unbounded) return b;
+			bound r = a;
+			for (auto& t : b.terms) r.terms[t.first] = std::max(r.terms[t.first], t.second);
+			return r;
+		}
+
+		std::string at_most(const bound& b) {
+			if (b.unbounded) return "unbounded (" + b.why + ")";
+			std::string s;
+			//highest degree first
+			for (auto t = b.terms.rbegin(); t != b.terms.rend(); ++t) {
+				if (!t->second) continue;
+				std::string term = (t->second != 1 || t->first.empty()) ? std::to_string(t->second) : "";
+				for (auto& f : t->first) term += (term.empty() ? "" : "*") + f;
+				s += (s.empty() ? "" : " + ") + term;
+			}
+			return "at most " + (s.empty() ? "0" : s);
+		}
+
+		//code line split into its keyword and parameters
+		struct op {
+			std::string name;
+			int par = 0; //parameter of LIT, JMP, JMC, CALL, INIT, RET, SPAWN and the indirect operations
+			int count = 0; //arguments of SPAWN
+			std::string cell; //memory cell of a direct memory operation, e.g. "1" or "local,-3"
+		};
+
+		op decode(const std::string& line) {
+			op o;
+			std::istringstream ls {line};
+			std::string text;
+			ls >> std::ws;
+			std::getline(ls, text, ';');
+			size_t paren = text.find('(');
+			if (paren != std::string::npos) {
+				o.name = text.substr(0, paren);
+				std::string in = text.substr(paren + 1, text.find(')') - paren - 1);
+				size_t comma = in.find(',');
+				o.par = std::atoi(in.substr((comma == std::string::npos) ? 0 : comma + 1).c_str());
+				if (comma != std::string::npos) {
+					std::string visible = in.substr(0, comma);
+					o.cell = ((visible == "lokal") ? "local" : visible) + "," + std::to_string(o.par);
+				}
+			}
+			else {
+				std::istringstream ps {text};
+				ps >> o.name >> o.par;
+				if (ps.get() == ',') ps >> o.count;
+				if (o.name == "LOAD" || o.name == "STORE" || o.name == "READ" || o.name == "WRITE") o.cell = std::to_string(o.par);
+			}
+			return o;
+		}
+
+		//value of the constant propagation: unknown, a constant or a symbol plus a constant
+		struct value {
+			bool known = false;
+			std::string sym;
+			long long c = 0;
+			value() = default;
+			value(const std::string& s, long long v) : known(true), sym(s), c(v) {}
+			bool operator==(const value& v) const { return known == v.known && (!known || (sym == v.sym && c == v.c)); }
+		};
+
+		//"a" - "b" if it can be expressed by a value
+		value difference(const value& a, const value& b) {
+			if (!a.known || !b.known) return value();
+			if (b.sym == "") return value(a.sym, a.c - b.c);
+			if (a.sym == b.sym) return value("", a.c - b.c);
+			return value();
+		}
+
+		//state of the constant propagation at a line
+		struct state {
+			bool reached = false;
+			bool clobbered = false; //cells a call may have changed are unknown, unless they are in "cells"
+			std::map<std::string,value> cells; //other cells have their value of the beginning of the procedure
+			std::vector<value> stack; //top of the data stack, the values below are unknown
+			std::vector<value> pushed; //top of the runtime stack pushed by PUSH for the next call
+		};
+
+		//loop found by its back edges
+		struct loop {
+			unsigned int header;
+			std::set<unsigned int> body;
+			bound iterations;
+		};
+
+		//results of a procedure, which starts at a line
+		struct procedure {
+			bool done = false, active = false;
+			bool recursive = false;
+			std::set<unsigned int> body; //lines reachable from the beginning
+			std::set<unsigned int> calls;
+			std::set<std::string> address_taken; //local cells loaded by LOADA
+			std::vector<loop> loops; //innermost first
+			std::string irregular; //reason why the control flow can't be bounded
+			std::map<unsigned int,state> in; //constant propagation at the beginning of every line
+			bound cost, d_max, rt_max;
+			bool returns = false, d_net_known = true, ret_known = true;
+			long long d_net = 0; //change of the data stack depth by the procedure
+			int ret_n = 0; //arguments removed by RET
+		};
+
+		class analysis {
+			public:
+				analysis(const std::vector<std::string>&, bool);
+				void write(std::ostream&);
+			private:
+				std::vector<op> ops;
+				bool runtime_stack;
+				std::map<unsigned int,procedure> procs;
+
+				std::vector<unsigned int> successors(unsigned int) const;
+				procedure& summary(unsigned int);
+				void find_loops(procedure&, unsigned int);
+				bool clobberable(const procedure&, const std::string&) const;
+				value get(const procedure&, const state&, const std::string&) const;
+				state transfer(const procedure&, state, const op&) const;
+				bool merge(const procedure&, state&, const state&) const;
+				void propagate(const procedure&, unsigned int, std::map<unsigned int,state>&) const;
+				int update(const loop&, const std::string&) const;
+				bound iterations(const procedure&, unsigned int, const loop&, std::map<unsigned int,state>&) const;
+				bound call_cost(const procedure&, unsigned int);
+				bound longest(const procedure&, const std::set<unsigned int>&, unsigned int, unsigned int);
+				void depths(procedure&, unsigned int);
+		};
+
+		analysis::analysis(const std::vector<std::string>& code, bool rt) : runtime_stack(rt) {
+			for (auto& line : code) ops.push_back(decode(line));
+		}
+
+		//lines following line "l", lines beyond the code end the program
+		std::vector<unsigned int> analysis::successors(unsigned int l) const {
+			const op& o = ops[l - 1];
+			std::vector<unsigned int> s;
+			if (o.name != "JMP" && o.name != "RET" && l < ops.size()) s.push_back(l + 1);
+			if ((o.name == "JMP" || o.name == "JMC") && o.par > 0 && (size_t) o.par <= ops.size()) s.push_back(o.par);
+			return s;
+		}
+
+		//analyse the procedure starting at line "entry" and the procedures it calls
+		procedure& analysis::summary(unsigned int entry) {
+			procedure& p = procs[entry];
+			if (p.done || p.active) return p;
+			p.active = true;
+			std::vector<unsigned int> todo {entry};
+			while (!todo.empty()) {
+				unsigned int l = todo.back();
+				todo.pop_back();
+				if (!p.body.insert(l).second) continue;
+				for (auto s : successors(l)) todo.push_back(s);
+				const op& o = ops[l - 1];
+				if ((o.name == "CALL" || o.name == "SPAWN") && o.par > 0 && (size_t) o.par <= ops.size()) p.calls.insert(o.par);
+				if (o.name == "LOADA" && !o.cell.compare(0, 6, "local,")) p.address_taken.insert(o.cell);
+			}
+			find_loops(p, entry);
+			propagate(p, entry, p.in);
+			for (auto& L : p.loops) L.iterations = iterations(p, entry, L, p.in);
+			p.cost = p.irregular.empty() ? longest(p, p.body, entry, 0) : bound::none(p.irregular);
+			depths(p, entry);
+			p.active = false;
+			p.done = true;
+			return p;
+		}
+
+		//find the natural loops of a procedure by the back edges of a depth first search
+		void analysis::find_loops(procedure& p, unsigned int entry) {
+			std::map<unsigned int,std::vector<unsigned int>> preds;
+			for (auto l : p.body) for (auto s : successors(l)) preds[s].push_back(l);
+			std::map<unsigned int,int> mark; //1: on the search path, 2: finished
+			std::vector<std::pair<unsigned int,unsigned int>> back;
+			std::function<void(unsigned int)> dfs = [&] (unsigned int l) {
+				mark[l] = 1;
+				for (auto s : successors(l)) {
+					if (mark[s] == 1) back.push_back({l, s});
+					else if (!mark[s]) dfs(s);
+				}
+				mark[l] = 2;
+			};
+			dfs(entry);
+			for (auto& b : back) {
+				//all lines reaching the back edge without passing the header
+				std::set<unsigned int> body {b.second};
+				std::vector<unsigned int> todo {b.first};
+				while (!todo.empty()) {
+					unsigned int l = todo.back();
+					todo.pop_back();
+					if (!body.insert(l).second) continue;
+					//the loop can be entered beside its header
+					if (l == entry) p.irregular = "irreducible control flow";
+					for (auto x : preds[l]) todo.push_back(x);
+				}
+				auto L = std::find_if(p.loops.begin(), p.loops.end(), [&] (const loop& x) { return x.header == b.second; });
+				if (L == p.loops.end()) p.loops.push_back({b.second, body, 0});
+				else L->body.insert(body.begin(), body.end());
+			}
+			std::sort(p.loops.begin(), p.loops.end(), [] (const loop& a, const loop& b) { return a.body.size() < b.body.size(); });
+		}
+
+		//check if a call or an indirect write may change "cell"
+		bool analysis::clobberable(const procedure& p, const std::string& cell) const {
+			return cell.compare(0, 6, "local,") || p.address_taken.count(cell);
+		}
+
+		//value of "cell" in state "s"
+		value analysis::get(const procedure& p, const state& s, const std::string& cell) const {
+			auto v = s.cells.find(cell);
+			if (v != s.cells.end()) return v->second;
+			if (s.clobbered && clobberable(p, cell)) return value();
+			return value("[" + cell + "]", 0);
+		}
+
+		//state after running "o" in state "s"
+		state analysis::transfer(const procedure& p, state s, const op& o) const {
+			auto pop = [&s] () {
+				value v;
+				if (!s.stack.empty()) {
+					v = s.stack.back();
+					s.stack.pop_back();
+				}
+				return v;
+			};
+			auto clobber = [&] () {
+				s.clobbered = true;
+				for (auto c = s.cells.begin(); c != s.cells.end();) {
+					if (clobberable(p, c->first)) c = s.cells.erase(c);
+					else ++c;
+				}
+			};
+			const std::string& n = o.name;
+			if (n == "LIT") s.stack.push_back(value("", o.par));
+			else if (n == "LOAD" && o.cell != "") s.stack.push_back(get(p, s, o.cell));
+			else if (n == "STORE" && o.cell != "") s.cells[o.cell] = pop();
+			else if (n == "READ" && o.cell != "") s.cells[o.cell] = value("[" + o.cell + "]", 0);
+			else if (n == "ADD" || n == "SUB") {
+				value b = pop(), a = pop();
+				if (n == "SUB") s.stack.push_back(difference(a, b));
+				else if (a.known && b.known && (a.sym == "" || b.sym == "")) s.stack.push_back(value(a.sym + b.sym, a.c + b.c));
+				else s.stack.push_back(value());
+			}
+			else if (n == "MUL" || n == "DIV" || n == "MOD" || n == "LT" || n == "EQ" || n == "NE" || n == "GT" ||
+				n == "LE" || n == "GE" || n == "ALLOC") {
+				pop();
+				if (n != "ALLOC") pop();
+				s.stack.push_back(value());
+			}
+			else if (n == "LOADI" || n == "LOADA") s.stack.push_back(value());
+			else if (n == "PUSH") s.pushed.push_back(pop());
+			else if (n == "JMC" || n == "FREE") pop();
+			else if (n == "STOREI") { pop(); clobber(); }
+			else if (n == "READI") clobber();
+			else if (n == "CALL" || n == "SPAWN" || n == "JOIN") {
+				clobber();
+				s.stack.clear();
+				s.pushed.clear();
+			}
+			return s;
+		}
+
+		//merge state "s" into state "d", returns true if "d" has changed
+		bool analysis::merge(const procedure& p, state& d, const state& s) const {
+			if (!d.reached) {
+				d = s;
+				d.reached = true;
+				return true;
+			}
+			state r;
+			r.reached = true;
+			r.clobbered = d.clobbered || s.clobbered;
+			std::set<std::string> keys;
+			for (auto& c : d.cells) keys.insert(c.first);
+			for (auto& c : s.cells) keys.insert(c.first);
+			for (auto& k : keys) {
+				value a = get(p, d, k);
+				r.cells[k] = (a == get(p, s, k)) ? a : value();
+			}
+			auto top = [] (const std::vector<value>& a, const std::vector<value>& b, std::vector<value>& to) {
+				size_t n = std::min(a.size(), b.size());
+				for (size_t i = 0; i < n; ++i) {
+					const value& v = a[a.size() - n + i];
+					to.push_back((v == b[b.size() - n + i]) ? v : value());
+				}
+			};
+			top(d.stack, s.stack, r.stack);
+			top(d.pushed, s.pushed, r.pushed);
+			bool changed = r.clobbered != d.clobbered || r.stack.size() != d.stack.size() || r.pushed.size() != d.pushed.size();
+			for (size_t i = 0; !changed && i < r.stack.size(); ++i) changed = !(r.stack[i] == d.stack[i]);
+			for (size_t i = 0; !changed && i < r.pushed.size(); ++i) changed = !(r.pushed[i] == d.pushed[i]);
+			for (auto& k : keys) if (!changed) changed = !(get(p, r, k) == get(p, d, k));
+			d = r;
+			return changed;
+		}
+
+		//constant propagation through a procedure, "in" gets the state at the beginning of every line
+		void analysis::propagate(const procedure& p, unsigned int entry, std::map<unsigned int,state>& in) const {
+			in[entry].reached = true;
+			std::vector<unsigned int> todo {entry};
+			while (!todo.empty()) {
+				unsigned int l = todo.back();
+				todo.pop_back();
+				state out = transfer(p, in[l], ops[l - 1]);
+				for (auto s : successors(l)) if (merge(p, in[s], out)) todo.push_back(s);
+			}
+		}
+
+		//step of the only change of "cell" in loop "L", which has to be LOAD cell; LIT k; ADD or SUB; STORE cell;
+		//returns 0 if there is no such change or if a path through the loop doesn't pass it
+		int analysis::update(const loop& L, const std::string& cell) const {
+			unsigned int at = 0;
+			for (auto l : L.body) {
+				const op& o = ops[l - 1];
+				if ((o.name == "STORE" || o.name == "READ") && o.cell == cell) {
+					if (at) return 0;
+					at = l;
+				}
+			}
+			if (at < 4 || ops[at - 1].name != "STORE" || !L.body.count(at - 3)) return 0;
+			const op& load = ops[at - 4], & lit = ops[at - 3], & arith = ops[at - 2];
+			if (load.name != "LOAD" || load.cell != cell || lit.name != "LIT" || (arith.name != "ADD" && arith.name != "SUB"))
+				return 0;
+			int step = (arith.name == "ADD") ? lit.par : -lit.par;
+			//without the change, the header must not be reachable again
+			std::set<unsigned int> seen;
+			std::vector<unsigned int> todo {L.header};
+			while (!todo.empty()) {
+				unsigned int l = todo.back();
+				todo.pop_back();
+				if (l == at || !seen.insert(l).second) continue;
+				for (auto s : successors(l)) {
+					if (s == L.header) return 0;
+					if (L.body.count(s)) todo.push_back(s);
+				}
+			}
+			return step;
+		}
+
+		//bound of the iterations of a counter loop
+		//its header compares the counter with a limit and leaves the loop by JMC. The counter is changed by a constant
+		//step on every path through the loop and the limit isn't changed in the loop at all
+		bound analysis::iterations(const procedure& p, unsigned int entry, const loop& L, std::map<unsigned int,state>& in) const {
+			bound none = bound::none("no bound of the loop at line " + std::to_string(L.header));
+			unsigned int h = L.header;
+			if (h + 3 > ops.size() || !L.body.count(h + 1) || !L.body.count(h + 2) || !L.body.count(h + 3)) return none;
+			const op& x = ops[h - 1], & y = ops[h], & exit = ops[h + 2];
+			std::string cmp = ops[h + 1].name;
+			if (x.name != "LOAD" || x.cell == "" || (y.name != "LOAD" && y.name != "LIT") || exit.name != "JMC" ||
+				L.body.count(exit.par) || !L.body.count(h + 4)) return none;
+			std::string counter = x.cell, limit = (y.name == "LOAD") ? y.cell : "";
+			int step = update(L, counter);
+			//the counter may be the second operand
+			if (!step && limit != "" && (step = update(L, limit))) {
+				std::swap(counter, limit);
+				std::map<std::string,std::string> flipped {{"LT", "GT"}, {"GT", "LT"}, {"LE", "GE"}, {"GE", "LE"}, {"NE", "NE"}};
+				cmp = flipped.count(cmp) ? flipped[cmp] : "";
+			}
+			if (!step) return none;
+			bool changes = false, clobbers = false;
+			for (auto l : L.body) {
+				const op& o = ops[l - 1];
+				if ((o.name == "STORE" || o.name == "READ") && limit != "" && o.cell == limit) changes = true;
+				if (o.name == "CALL" || o.name == "SPAWN" || o.name == "JOIN" || o.name == "STOREI" || o.name == "READI") clobbers = true;
+			}
+			if (changes || (clobbers && (clobberable(p, counter) || (limit != "" && clobberable(p, limit))))) return none;
+			//state when entering the loop
+			state start;
+			if (h == entry) merge(p, start, state());
+			for (auto l : p.body) {
+				if (L.body.count(l)) continue;
+				for (auto s : successors(l)) if (s == h) merge(p, start, transfer(p, in[l], ops[l - 1]));
+			}
+			if (!start.reached) return none;
+			value first = get(p, start, counter), last = (limit == "") ? value("", y.par) : get(p, start, limit);
+			//distance the counter has to go in the direction of the loop
+			value d;
+			if (step > 0 && (cmp == "LT" || cmp == "LE" || cmp == "NE")) d = difference(last, first);
+			else if (step < 0 && (cmp == "GT" || cmp == "GE" || cmp == "NE")) d = difference(first, last);
+			long long k = std::abs(step);
+			if (!d.known || (cmp == "NE" && (k != 1 || d.sym != "" || d.c < 0))) return none;
+			if (cmp == "LE" || cmp == "GE") d.c += 1;
+			if (d.sym == "") return bound((d.c <= 0) ? 0 : (d.c + k - 1) / k);
+			return bound(d.sym) + bound(std::max(0ll, d.c));
+		}
+
+		//bound of the instructions of the call at line "l" of procedure "p"
+		//the cells in the bound of the callee are replaced by the arguments and the values of the global cells at the call
+		bound analysis::call_cost(const procedure& p, unsigned int l) {
+			const op& o = ops[l - 1];
+			if (o.par <= 0 || (size_t) o.par > ops.size()) return 0;
+			procedure& c = summary(o.par);
+			if (c.active) {
+				c.recursive = true;
+				return bound::none("recursion");
+			}
+			if (c.cost.unbounded) return c.cost;
+			auto at = p.in.find(l);
+			state s = (at == p.in.end()) ? state() : at->second;
+			bound r;
+			for (auto& t : c.cost.terms) {
+				bound term {t.second};
+				for (auto& f : t.first) {
+					std::string cell = f.substr(1, f.size() - 2);
+					value v;
+					if (cell.compare(0, 7, "local,-")) v = get(p, s, cell);
+					else {
+						//the last pushed argument is at local,-2
+						size_t k = std::atoi(cell.substr(7).c_str());
+						if (k >= 2 && k - 2 < s.pushed.size()) v = s.pushed[s.pushed.size() - 1 - (k - 2)];
+					}
+					if (!v.known) return bound::none("the cost of line " + std::to_string(o.par) + " depends on an unknown value of " + f);
+					term = term * ((v.sym == "") ? bound(std::max(0ll, v.c)) : bound(v.sym) + bound(std::max(0ll, v.c)));
+				}
+				r = r + term;
+			}
+			return r;
+		}
+
+		//bound of the instructions on the longest path from "start" through "region", where inner loops count as a whole
+		//paths end at a back edge to "header", when leaving the region or at the end of the procedure
+		bound analysis::longest(const procedure& p, const std::set<unsigned int>& region, unsigned int start, unsigned int header) {
+			//the outermost loops inside the region, the loops are sorted innermost first
+			std::vector<const loop*> inner;
+			for (auto& L : p.loops) {
+				if (L.header == header || !region.count(L.header)) continue;
+				inner.erase(std::remove_if(inner.begin(), inner.end(), [&] (const loop* i) { return L.body.count(i->header); }),
+					inner.end());
+				inner.push_back(&L);
+			}
+			//lines are nodes of their own, inner loops are nodes with negative numbers
+			auto node = [&] (unsigned int l) -> int {
+				for (size_t i = 0; i < inner.size(); ++i) if (inner[i]->body.count(l)) return -(int) i - 1;
+				return l;
+			};
+			std::map<int,bound> memo;
+			std::set<int> visiting;
+			std::function<bound(int)> from = [&] (int n) -> bound {
+				auto m = memo.find(n);
+				if (m != memo.end()) return m->second;
+				if (visiting.count(n)) return bound::none("irreducible control flow");
+				visiting.insert(n);
+				bound own;
+				std::vector<unsigned int> next;
+				if (n > 0) {
+					const op& o = ops[n - 1];
+					own = bound(1) + ((o.name == "CALL" || o.name == "SPAWN") ? call_cost(p, n) : bound());
+					next = successors(n);
+				}
+				else {
+					const loop& L = *inner[-n - 1];
+					//the last run through the header leaves the loop
+					own = (L.iterations + bound(1)) * longest(p, L.body, L.header, L.header);
+					for (auto l : L.body) for (auto s : successors(l)) if (!L.body.count(s)) next.push_back(s);
+				}
+				bound best;
+				for (auto s : next) if (s != header && region.count(s) && node(s) != n) best = max(best, from(node(s)));
+				visiting.erase(n);
+				return memo[n] = own + best;
+			};
+			return from(node(start));
+		}
+
+		//bounds of the data stack and runtime stack depth of a procedure, relative to their depth at its beginning
+		void analysis::depths(procedure& p, unsigned int entry) {
+			long long d_peak = 0, rt_peak = 0;
+			std::string d_why, rt_why;
+			std::map<unsigned int,std::pair<long long,long long>> height;
+			std::map<unsigned int,std::pair<unsigned int,unsigned int>> raised;
+			height[entry] = {0, 0};
+			std::vector<unsigned int> todo {entry};
+			while (!todo.empty()) {
+				unsigned int l = todo.back();
+				todo.pop_back();
+				const op& o = ops[l - 1];
+				long long d = height[l].first, rt = height[l].second;
+				long long d_top = d, rt_top = rt;
+				const std::string& n = o.name;
+				if (n == "CALL") {
+					if (o.par <= 0 || (size_t) o.par > ops.size()) continue;
+					procedure& c = summary(o.par);
+					if (c.active) {
+						c.recursive = true;
+						d_why = rt_why = "recursion";
+					}
+					else {
+						if (c.d_max.unbounded) d_why = c.d_max.why;
+						else if (!c.d_net_known) d_why = "the data stack depth after a call of line " + std::to_string(o.par) + " varies";
+						if (c.rt_max.unbounded) rt_why = c.rt_max.why;
+						else if (!c.ret_known) rt_why = "line " + std::to_string(o.par) + " returns by different RET";
+						d_top = d + c.d_max.value();
+						rt_top = rt + 2 + c.rt_max.value();
+						d += c.d_net;
+						rt -= c.ret_n;
+					}
+				}
+				else if (n == "RET") {
+					if (!p.returns) {
+						p.returns = true;
+						p.ret_n = o.par;
+						p.d_net = d;
+					}
+					p.ret_known = p.ret_known && p.ret_n == o.par;
+					p.d_net_known = p.d_net_known && p.d_net == d;
+				}
+				else if (n == "LIT" || n == "LOAD" || n == "LOADI" || n == "LOADA") ++d;
+				else if (n == "ADD" || n == "SUB" || n == "MUL" || n == "DIV" || n == "MOD" || n == "LT" || n == "EQ" || n == "NE" ||
+					n == "GT" || n == "LE" || n == "GE" || n == "STORE" || n == "STOREI" || n == "JMC" || n == "FREE") --d;
+				else if (n == "PUSH") { --d; ++rt; }
+				else if (n == "INIT") rt += o.par;
+				else if (n == "SPAWN") rt -= o.count;
+				d_peak = std::max(d_peak, std::max(d_top, d));
+				rt_peak = std::max(rt_peak, std::max(rt_top, rt));
+				for (auto s : successors(l)) {
+					bool grows = false;
+					auto h = height.find(s);
+					if (h == height.end()) {
+						height[s] = {d, rt};
+						grows = true;
+					}
+					else {
+						//a depth raised more often than there are lines grows in a loop
+						if (d_why == "" && d > h->second.first) {
+							h->second.first = d;
+							grows = true;
+							if (++raised[s].first > p.body.size()) d_why = "the data stack grows in a loop";
+						}
+						if (rt_why == "" && rt > h->second.second) {
+							h->second.second = rt;
+							grows = true;
+							if (++raised[s].second > p.body.size()) rt_why = "the runtime stack grows in a loop";
+						}
+					}
+					if (grows) todo.push_back(s);
+				}
+			}
+			p.d_max = (d_why == "") ? bound(d_peak) : bound::none(d_why);
+			p.rt_max = (rt_why == "") ? bound(rt_peak) : bound::none(rt_why);
+		}
+
+		//analyse all procedures reachable from the first line and write the results
+		void analysis::write(std::ostream& os) {
+			os << "Static analysis:\n";
+			if (ops.empty()) return;
+			summary(1);
+			for (auto& x : procs) {
+				procedure& p = x.second;
+				os << ((x.first == 1) ? "Program" : "Procedure") << " at line " << x.first << (p.recursive ? " (recursive)" : "") << ":\n";
+				if (!p.calls.empty()) {
+					os << "  calls lines";
+					for (auto c : p.calls) os << " " << c;
+					os << "\n";
+				}
+				for (auto& L : p.loops) os << "  loop at lines " << L.header << "-" << *L.body.rbegin() << ": " <<
+					(L.iterations.unbounded ? "no bound derived" : at_most(L.iterations) + " iterations") << "\n";
+				os << "  instructions: " << at_most(p.cost) << "\n";
+				os << "  data stack: " << at_most(p.d_max) << "\n";
+				if (runtime_stack) os << "  runtime stack: " << at_most(p.rt_max) << "\n";
+				else {
+					std::set<std::string> cells;
+					for (auto l : p.body) if (ops[l - 1].cell != "") cells.insert(ops[l - 1].cell);
+					os << "  memory cells: " << cells.size() << "\n";
+				}
+			}
+			os << "[c] is the value of memory cell c when its procedure starts or when it is read, assumed to be non-negative\n";
+		}
+	}
+
+	//estimate the costs of a program without running it
+	void write_analysis(std::ostream& os, const std::vector<std::string>& code, bool runtime_stack) {
+		analysis a {code, runtime_stack};
+		a.write(os);
+	}
+}
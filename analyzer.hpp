@@ -0,0 +1,11 @@
+#include <string>
+#include <vector>
+#include <ostream>
+
+namespace am0_interpreter {
+	//estimate the costs of a program without running it
+	//the control flow and call graph of the code lines are built, loops are found and bounds of simple counter loops
+	//are derived. Per procedure the instruction count, the depth of the data stack and, if "runtime_stack" is true,
+	//the depth of the runtime stack are bounded
+	void write_analysis(std::ostream&, const std::vector<std::string>&, bool runtime_stack);
+}
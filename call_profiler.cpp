@@ -0,0 +1,95 @@
+#include <iomanip>
+#include <algorithm>
+#include "call_profiler.hpp"
+
+namespace am1_interpreter {
+	//start profiling in the procedure at line "entry" at step "steps", it stays at the bottom of the shadow stack
+	call_profiler::call_profiler(unsigned int entry, unsigned long long steps) {
+		tree.emplace_back(entry, 0);
+		push(entry, 0, steps, clock::now());
+	}
+
+	//the procedure at line "entry" was called at step "steps"
+	void call_profiler::enter(unsigned int entry, unsigned long long steps) {
+		clock::time_point now = clock::now();
+		size_t parent = stack.back().node;
+		auto c = tree[parent].children.find(entry);
+		size_t n;
+		if (c != tree[parent].children.end()) n = c->second;
+		else {
+			n = tree.size();
+			tree[parent].children[entry] = n;
+			tree.emplace_back(entry, parent);
+		}
+		push(entry, n, steps, now);
+	}
+
+	//the current procedure returned at step "steps"
+	//a RET without a matching CALL can't leave the bottom of the shadow stack
+	void call_profiler::leave(unsigned long long steps) {
+		if (stack.size() > 1) pop(steps, clock::now());
+	}
+
+	//return from all procedures still running at step "steps", including the one profiling started in
+	void call_profiler::finish(unsigned long long steps) {
+		clock::time_point now = clock::now();
+		while (!stack.empty()) pop(steps, now);
+	}
+
+	void call_profiler::push(unsigned int entry, size_t n, unsigned long long steps, clock::time_point now) {
+		stack.push_back({entry, n, steps, 0, now, clock::duration {0}});
+		totals& t = procedures[entry];
+		++t.calls;
+		++t.active;
+	}
+
+	void call_profiler::pop(unsigned long long steps, clock::time_point now) {
+		frame f = stack.back();
+		stack.pop_back();
+		unsigned long long inclusive_steps = steps - f.start_steps;
+		clock::duration inclusive_time = now - f.start;
+		totals& t = procedures[f.entry];
+		t.exclusive_steps += inclusive_steps - f.child_steps;
+		t.exclusive_time += inclusive_time - f.child_time;
+		if (!--t.active) {
+			t.inclusive_steps += inclusive_steps;
+			t.inclusive_time += inclusive_time;
+		}
+		tree[f.node].steps += inclusive_steps - f.child_steps;
+		if (!stack.empty()) {
+			stack.back().child_steps += inclusive_steps;
+			stack.back().child_time += inclusive_time;
+		}
+	}
+
+	//table of all procedures, sorted by their exclusive instructions
+	void call_profiler::write_summary(std::ostream& os, const namer& name) const {
+		std::vector<std::pair<unsigned int,const totals*>> sorted;
+		for (auto& p : procedures) sorted.push_back({p.first, &p.second});
+		std::stable_sort(sorted.begin(), sorted.end(), [] (const std::pair<unsigned int,const totals*>& a,
+			const std::pair<unsigned int,const totals*>& b) { return a.second->exclusive_steps > b.second->exclusive_steps; });
+		auto ms = [] (clock::duration d) { return std::chrono::duration<double,std::milli>(d).count(); };
+		os << "Call profile:\n" << std::right << std::setw(12) << "CALLS" << std::setw(16) << "INCL STEPS" <<
+			std::setw(16) << "EXCL STEPS" << std::setw(12) << "INCL MS" << std::setw(12) << "EXCL MS" << "  PROCEDURE\n";
+		for (auto& p : sorted) {
+			const totals& t = *p.second;
+			os << std::setw(12) << t.calls << std::setw(16) << t.inclusive_steps << std::setw(16) << t.exclusive_steps <<
+				std::fixed << std::setprecision(3) << std::setw(12) << ms(t.inclusive_time) << std::setw(12) <<
+				ms(t.exclusive_time) << "  " << name(p.first) << "\n";
+		}
+	}
+
+	//one line per call stack with its exclusive instructions, the procedures from the bottom up seperated by ';'
+	void call_profiler::write_collapsed(std::ostream& os, const namer& name) const {
+		for (size_t n = 0; n < tree.size(); ++n) {
+			if (!tree[n].steps) continue;
+			std::vector<std::string> names;
+			for (size_t i = n;; i = tree[i].parent) {
+				names.push_back(name(tree[i].entry));
+				if (!i) break;
+			}
+			for (auto x = names.rbegin(); x != names.rend(); ++x) os << ((x == names.rbegin()) ? "" : ";") << *x;
+			os << " " << tree[n].steps << "\n";
+		}
+	}
+}
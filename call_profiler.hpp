@@ -0,0 +1,52 @@
+#include <map>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ostream>
+#include <functional>
+
+namespace am1_interpreter {
+	//instrumenting profiler of the procedures of AM1
+	//CALL and RET maintain a shadow call stack of procedure entry lines, so the instructions and the time are
+	//attributed to every procedure inclusive and exclusive of the procedures it calls
+	class call_profiler {
+		public:
+			typedef std::function<std::string(unsigned int)> namer; //name of the procedure at a line
+			call_profiler(unsigned int, unsigned long long); //start profiling in the procedure at a line at a step
+			void enter(unsigned int, unsigned long long); //the procedure at a line was called at a step
+			void leave(unsigned long long); //the current procedure returned at a step
+			void finish(unsigned long long); //return from all procedures still running at the end
+			void write_summary(std::ostream&, const namer&) const; //table of all procedures, the slowest first
+			void write_collapsed(std::ostream&, const namer&) const; //call stacks in the format of flamegraph tools
+		private:
+			typedef std::chrono::steady_clock clock;
+			//node of the tree of all call stacks
+			struct node {
+				unsigned int entry;
+				size_t parent;
+				std::map<unsigned int,size_t> children;
+				unsigned long long steps = 0; //exclusive instructions of this call stack
+				node(unsigned int e, size_t p) : entry(e), parent(p) {}
+			};
+			//procedure on the shadow call stack
+			struct frame {
+				unsigned int entry;
+				size_t node;
+				unsigned long long start_steps, child_steps;
+				clock::time_point start;
+				clock::duration child_time;
+			};
+			//totals of a procedure, inclusive totals only count the outermost of recursive calls
+			struct totals {
+				unsigned long long calls = 0, inclusive_steps = 0, exclusive_steps = 0;
+				clock::duration inclusive_time {0}, exclusive_time {0};
+				unsigned int active = 0;
+			};
+			std::vector<node> tree;
+			std::vector<frame> stack;
+			std::map<unsigned int,totals> procedures;
+
+			void push(unsigned int, size_t, unsigned long long, clock::time_point); //put a procedure on the shadow stack
+			void pop(unsigned long long, clock::time_point); //remove the topmost procedure from the shadow stack
+	};
+}
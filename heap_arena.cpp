@@ -0,0 +1,77 @@
+#include "heap_arena.hpp"
+
+namespace am1_interpreter {
+	//arena of the given number of cells
+	heap_arena::heap_arena(unsigned int size) : cells(size), state(size), free_blocks(32) {}
+
+	//allocate a block of at least "n" cells, all set to 0
+	//returns its address or 0 if there is no space left
+	unsigned int heap_arena::alloc(int n) {
+		if (n <= 0) return 0;
+		unsigned int c = 0;
+		while ((1u << c) < (unsigned int) n) ++c;
+		unsigned int size = 1u << c;
+		std::lock_guard<std::mutex> lock {m};
+		unsigned int offset;
+		if (!free_blocks[c].empty()) {
+			offset = free_blocks[c].back();
+			free_blocks[c].pop_back();
+		}
+		else if (size <= cells.size() - top) {
+			offset = top;
+			top += size;
+		}
+		else return 0;
+		//only the requested cells are allocated, the rest of the size class stays invalid
+		for (unsigned int i = offset; i < offset + n; ++i) {
+			cells[i].store(0, std::memory_order_relaxed);
+			state[i].store(1, std::memory_order_relaxed);
+		}
+		state[offset].store(2 + c, std::memory_order_relaxed);
+		in_use.fetch_add(size, std::memory_order_relaxed);
+		return base_address + offset + 1;
+	}
+
+	//free the block starting at address "adr"
+	//returns false if no block starts there
+	bool heap_arena::free(unsigned int adr) {
+		unsigned int offset = adr - base_address - 1;
+		std::lock_guard<std::mutex> lock {m};
+		if (adr <= base_address || offset >= top || state[offset].load(std::memory_order_relaxed) < 2) return false;
+		unsigned int c = state[offset].load(std::memory_order_relaxed) - 2;
+		for (unsigned int i = offset; i < offset + (1u << c); ++i) state[i].store(0, std::memory_order_relaxed);
+		free_blocks[c].push_back(offset);
+		in_use.fetch_sub(1u << c, std::memory_order_relaxed);
+		return true;
+	}
+
+	//cell at address "adr", nullptr if it isn't part of an allocated block
+	std::atomic<int>* heap_arena::at(unsigned int adr) {
+		unsigned int offset = adr - base_address - 1;
+		if (adr <= base_address || offset >= cells.size() || !state[offset].load(std::memory_order_relaxed)) return nullptr;
+		return &cells[offset];
+	}
+
+	//append the complete state of the heap, two heaps with equal snapshots behave equally from then on
+	void heap_arena::snapshot(std::vector<int>& s) {
+		std::lock_guard<std::mutex> lock {m};
+		s.push_back(top);
+		for (auto& f : free_blocks) {
+			s.push_back(f.size());
+			s.insert(s.end(), f.begin(), f.end());
+		}
+		for (unsigned int i = 0; i < top; ++i) {
+			s.push_back(state[i].load(std::memory_order_relaxed));
+			s.push_back(cells[i].load(std::memory_order_relaxed));
+		}
+	}
+
+	//free all blocks at once
+	void heap_arena::reset() {
+		std::lock_guard<std::mutex> lock {m};
+		for (unsigned int i = 0; i < top; ++i) state[i].store(0, std::memory_order_relaxed);
+		for (auto& f : free_blocks) f.clear();
+		top = 0;
+		in_use.store(0, std::memory_order_relaxed);
+	}
+}
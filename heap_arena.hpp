@@ -0,0 +1,31 @@
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+namespace am1_interpreter {
+	//heap of AM1, its cells have the addresses following "base_address"
+	//blocks are rounded up to a size class of a power of two, freed blocks are kept in a list per class and reused
+	//only the requested cells of a block are valid addresses
+	//the cells are atomic, so tasks running in parallel can share the heap
+	class heap_arena {
+		public:
+			static const unsigned int base_address = 1u << 30;
+			explicit heap_arena(unsigned int); //arena of the given number of cells
+			heap_arena(const heap_arena&) = delete;
+			heap_arena& operator=(const heap_arena&) = delete;
+			unsigned int alloc(int); //allocate a block, returns its address or 0 if there is no space left
+			bool free(unsigned int); //free the block starting at an address
+			std::atomic<int>* at(unsigned int); //cell at an address, nullptr if it isn't allocated
+			void reset(void); //free all blocks at once
+			void snapshot(std::vector<int>&); //append the complete state of the heap
+			size_t used(void) const { return in_use.load(std::memory_order_relaxed); } //allocated cells
+		private:
+			std::mutex m; //serialises alloc, free and reset
+			std::vector<std::atomic<int>> cells;
+			std::vector<std::atomic<unsigned char>> state; //0: free or behind the requested cells of a block, 1: allocated, 2 + size class: start of a block
+			std::vector<std::vector<unsigned int>> free_blocks; //offsets of freed blocks per size class
+			unsigned int top = 0; //cells up to top have been part of a block
+			std::atomic<size_t> in_use {0};
+	};
+}
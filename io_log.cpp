@@ -0,0 +1,58 @@
+#include <cstring>
+#include "io_log.hpp"
+
+namespace am0_interpreter {
+	static const char magic[4] = {'A', 'M', 'I', 'O'};
+
+	//create a log file to record into
+	bool io_log::open_record(const std::string& name) {
+		fs.open(name, std::ios::out | std::ios::binary | std::ios::trunc);
+		fs.write(magic, sizeof(magic));
+		return fs.good();
+	}
+
+	//open a recorded log file
+	bool io_log::open_replay(const std::string& name) {
+		fs.open(name, std::ios::in | std::ios::binary);
+		char head[sizeof(magic)];
+		return fs.read(head, sizeof(head)) && !std::memcmp(head, magic, sizeof(magic));
+	}
+
+	//record a value read at the given step
+	//values are zigzag encoded, so small negative values stay small
+	void io_log::put(int value, unsigned long long step) {
+		put_varint((static_cast<unsigned long long>(value) << 1) ^ static_cast<unsigned long long>(value >> 31));
+		put_varint(step - last_step);
+		last_step = step;
+		//a crashing run should still leave a complete log behind
+		fs.flush();
+	}
+
+	//get the next recorded value and its step
+	bool io_log::next(int& value, unsigned long long& step) {
+		unsigned long long v, distance;
+		if (!get_varint(v) || !get_varint(distance)) return false;
+		value = static_cast<int>(static_cast<unsigned int>(v >> 1) ^ -static_cast<unsigned int>(v & 1));
+		step = last_step += distance;
+		return true;
+	}
+
+	void io_log::put_varint(unsigned long long v) {
+		while (v >= 0x80) {
+			fs.put(static_cast<char>(v | 0x80));
+			v >>= 7;
+		}
+		fs.put(static_cast<char>(v));
+	}
+
+	bool io_log::get_varint(unsigned long long& v) {
+		v = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			int c = fs.get();
+			if (c == EOF) return false;
+			v |= static_cast<unsigned long long>(c & 0x7f) << shift;
+			if (!(c & 0x80)) return true;
+		}
+		return false;
+	}
+}
@@ -0,0 +1,20 @@
+#include <string>
+#include <fstream>
+
+namespace am0_interpreter {
+	//compact binary log of all values read by READ, used to record and replay a run
+	//file layout: "AMIO", then per value its zigzag varint followed by the varint step distance to the previous READ
+	class io_log {
+		public:
+			bool open_record(const std::string&); //create a log file to record into
+			bool open_replay(const std::string&); //open a recorded log file
+			void put(int, unsigned long long); //record a value read at the given step
+			bool next(int&, unsigned long long&); //get the next recorded value and its step
+		private:
+			std::fstream fs;
+			unsigned long long last_step = 0; //step of the previous value
+
+			void put_varint(unsigned long long);
+			bool get_varint(unsigned long long&);
+	};
+}
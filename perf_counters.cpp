@@ -0,0 +1,124 @@
+#include <iomanip>
+#include <cstring>
+#include "perf_counters.hpp"
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace perf_counters {
+	static const char* event_names[event_count] = {
+		"cycles", "instructions", "branch_misses", "cache_misses", "page_faults"
+	};
+
+	//opens one perf event per counter, unavailable counters are skipped
+	//every counter is opened on its own so a single missing hardware event doesn't disable the others
+	counter_group::counter_group() {
+		for (int i = 0; i < event_count; ++i) fd[i] = -1;
+#ifdef __linux__
+		static const struct { uint32_t type; uint64_t config; } events[event_count] = {
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+			{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS}
+		};
+		for (int i = 0; i < event_count; ++i) {
+			perf_event_attr attr;
+			std::memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = events[i].type;
+			attr.config = events[i].config;
+			attr.disabled = 1;
+			//user space only, this works with the default "perf_event_paranoid" setting
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			//threads created later, like the parsing thread while streaming or the workers of --parallel, count too
+			attr.inherit = 1;
+			fd[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+		}
+#endif
+	}
+
+	counter_group::~counter_group() {
+#ifdef __linux__
+		for (int i = 0; i < event_count; ++i) if (fd[i] >= 0) close(fd[i]);
+#endif
+	}
+
+	//check if at least one counter could be opened
+	bool counter_group::available() const {
+		for (int i = 0; i < event_count; ++i) if (fd[i] >= 0) return true;
+		return false;
+	}
+
+	//reset and enable all counters
+	void counter_group::start() {
+#ifdef __linux__
+		for (int i = 0; i < event_count; ++i) {
+			if (fd[i] < 0) continue;
+			ioctl(fd[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+		begin = std::chrono::steady_clock::now();
+	}
+
+	//disable all counters and read them out
+	sample counter_group::stop(const std::string& phase) {
+		sample s;
+		s.time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		s.phase = phase;
+#ifdef __linux__
+		for (int i = 0; i < event_count; ++i) {
+			if (fd[i] < 0) continue;
+			ioctl(fd[i], PERF_EVENT_IOC_DISABLE, 0);
+			uint64_t value;
+			if (::read(fd[i], &value, sizeof(value)) == sizeof(value)) {
+				s.value[i] = value;
+				s.valid[i] = true;
+			}
+		}
+#endif
+		return s;
+	}
+
+	//print the samples as a table
+	void report(std::ostream& os, const std::vector<sample>& samples) {
+		os << "Performance counters:\n" << std::left << std::setw(16) << "";
+		for (auto& s : samples) os << std::right << std::setw(16) << s.phase;
+		os << "\n";
+		for (int i = 0; i < event_count; ++i) {
+			os << std::left << std::setw(16) << event_names[i];
+			for (auto& s : samples) {
+				os << std::right << std::setw(16);
+				if (s.valid[i]) os << s.value[i];
+				else os << "n/a";
+			}
+			os << "\n";
+		}
+		os << std::left << std::setw(16) << "time_ms";
+		for (auto& s : samples) os << std::right << std::setw(16) << std::fixed << std::setprecision(3) << s.time_ms;
+		os << std::endl;
+	}
+
+	//print the samples as a JSON object
+	//unavailable counters are written as null
+	void report_json(std::ostream& os, const std::vector<sample>& samples) {
+		os << "{";
+		for (size_t p = 0; p < samples.size(); ++p) {
+			const sample& s = samples[p];
+			os << (p ? "," : "") << "\"" << s.phase << "\":{";
+			for (int i = 0; i < event_count; ++i) {
+				os << "\"" << event_names[i] << "\":";
+				if (s.valid[i]) os << s.value[i];
+				else os << "null";
+				os << ",";
+			}
+			os << "\"time_ms\":" << std::fixed << std::setprecision(3) << s.time_ms << "}";
+		}
+		os << "}" << std::endl;
+	}
+}
@@ -0,0 +1,36 @@
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+namespace perf_counters {
+	//hardware and software events collected for every phase
+	enum event {cycles, instructions, branch_misses, cache_misses, page_faults, event_count};
+
+	//counter values of one measured phase
+	//a counter that could not be opened (e.g. inside a container) is marked as not valid
+	struct sample {
+		std::string phase;
+		uint64_t value[event_count] = {};
+		bool valid[event_count] = {};
+		double time_ms = 0;
+	};
+
+	class counter_group {
+		public:
+			counter_group(); //opens one perf event per counter for the calling thread and the threads it creates later
+			~counter_group();
+			counter_group(const counter_group&) = delete;
+			counter_group& operator=(const counter_group&) = delete;
+			bool available() const; //check if at least one counter could be opened
+			void start(); //reset and enable all counters
+			sample stop(const std::string&); //disable all counters and read them out
+		private:
+			int fd[event_count];
+			std::chrono::steady_clock::time_point begin;
+	};
+
+	void report(std::ostream&, const std::vector<sample>&); //print the samples as a table
+	void report_json(std::ostream&, const std::vector<sample>&); //print the samples as a JSON object
+}
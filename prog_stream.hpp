@@ -0,0 +1,73 @@
+#include <mutex>
+#include <vector>
+#include <cstddef>
+#include <ostream>
+#include <streambuf>
+#include <condition_variable>
+
+namespace am0_interpreter {
+	//synchronisation between the parsing thread and the executing thread while streaming a program
+	class prog_stream_base {
+		public:
+			//block until at least "need" instructions are parsed or parsing has finished
+			//returns the amount of instructions parsed so far
+			size_t wait(size_t need) {
+				std::unique_lock<std::mutex> lock {m};
+				cv.wait(lock, [&] () { return closed || produced >= need; });
+				return produced;
+			}
+			//block until parsing has finished, returns true if the program was parsed without errors
+			bool wait_closed() {
+				std::unique_lock<std::mutex> lock {m};
+				cv.wait(lock, [&] () { return closed; });
+				return ok;
+			}
+			//called by the parsing thread at the end of the input
+			void close(bool success) {
+				std::lock_guard<std::mutex> lock {m};
+				closed = true;
+				ok = success;
+				cv.notify_all();
+			}
+		protected:
+			std::mutex m;
+			std::condition_variable cv;
+			size_t produced = 0; //amount of parsed instructions
+			bool closed = false; //parsing has finished
+			bool ok = false; //parsing has finished without errors
+	};
+
+	//instructions parsed but not yet taken over into the program code container of the executing thread
+	//the executing thread owns its program code container, so running doesn't need any locking
+	template<typename T> class prog_stream : public prog_stream_base {
+		public:
+			//called by the parsing thread for every parsed instruction
+			void push(const T& f) {
+				std::lock_guard<std::mutex> lock {m};
+				pending.push_back(f);
+				++produced;
+				cv.notify_all();
+			}
+			//move parsed instructions into "prog" until it contains at least "need" instructions
+			//returns false if parsing ended before
+			bool fetch(std::vector<T>& prog, size_t need) {
+				std::unique_lock<std::mutex> lock {m};
+				cv.wait(lock, [&] () { return closed || prog.size() + pending.size() >= need; });
+				for (auto& f : pending) prog.push_back(std::move(f));
+				pending.clear();
+				return prog.size() >= need;
+			}
+		private:
+			std::vector<T> pending;
+	};
+
+	//output stream which drops everything, used to silence the code listing while streaming
+	class null_ostream : public std::ostream {
+		public:
+			null_ostream() : std::ostream(&buf) {}
+		private:
+			struct null_buffer : std::streambuf {
+				int overflow(int c) override { return c; }
+			} buf;
+	};
+}
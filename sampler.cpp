@@ -0,0 +1,80 @@
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include "sampler.hpp"
+
+namespace am0_interpreter {
+	std::atomic<sampler*> sampler::active {nullptr};
+
+	//sample the machine "m" by "p" into a buffer of "size" samples
+	sampler::sampler(probe p, const void* m, size_t size) : take(p), machine(m), buffer(size) {}
+
+	//sample the calling thread every "interval" microseconds of its CPU time
+	//only one sampler can run at a time, returns false if the timer can't be created
+	bool sampler::start(unsigned int interval) {
+		if (armed || active.load()) return false;
+		//the handler stays installed, a signal still pending after stop finds no active sampler
+		struct sigaction sa {};
+		sa.sa_handler = handle;
+		sa.sa_flags = SA_RESTART;
+		sigemptyset(&sa.sa_mask);
+		if (sigaction(SIGPROF, &sa, nullptr)) return false;
+		//the signal interrupts the thread running the machine, so the handler sees its state between two writes
+		sigevent ev {};
+		ev.sigev_notify = SIGEV_THREAD_ID;
+		ev.sigev_signo = SIGPROF;
+		ev._sigev_un._tid = syscall(SYS_gettid);
+		if (timer_create(CLOCK_THREAD_CPUTIME_ID, &ev, &timer)) return false;
+		active.store(this);
+		itimerspec its {};
+		its.it_interval.tv_sec = interval / 1000000;
+		its.it_interval.tv_nsec = (interval % 1000000) * 1000;
+		its.it_value = its.it_interval;
+		if (timer_settime(timer, 0, &its, nullptr)) {
+			active.store(nullptr);
+			timer_delete(timer);
+			return false;
+		}
+		armed = true;
+		return true;
+	}
+
+	//no more samples are taken
+	void sampler::stop(void) {
+		if (!armed) return;
+		active.store(nullptr);
+		timer_delete(timer);
+		armed = false;
+	}
+
+	//all samples taken so far
+	std::vector<sample> sampler::samples(void) const {
+		return std::vector<sample>(buffer.begin(), buffer.begin() + count);
+	}
+
+	//copy "n" cells from "from", which may have been freed meanwhile, to "to"
+	//the kernel copies the cells, so an unmapped address fails instead of raising a signal in the handler
+	bool sampler::read_cells(const int* from, int* to, size_t n) {
+		iovec local {to, n * sizeof(int)}, remote {const_cast<int*>(from), n * sizeof(int)};
+		return process_vm_readv(getpid(), &local, 1, &remote, 1, 0) == (ssize_t) (n * sizeof(int));
+	}
+
+	//signal handler: record a sample of the machine
+	void sampler::handle(int) {
+		sampler* s = active.load();
+		if (!s || ++s->ticks % s->every) return;
+		int saved = errno;
+		if (s->count == s->buffer.size()) {
+			//keep every second sample
+			for (size_t i = 0; i < s->count / 2; ++i) s->buffer[i] = s->buffer[2 * i + 1];
+			s->count /= 2;
+			s->every *= 2;
+			s->ticks = 0;
+		}
+		s->take(s->machine, s->buffer[s->count]);
+		++s->count;
+		errno = saved;
+	}
+}
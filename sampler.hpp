@@ -0,0 +1,44 @@
+#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <ctime>
+
+namespace am0_interpreter {
+	//state of a machine taken by a sample
+	struct sample {
+		static const unsigned int max_depth = 16;
+		unsigned int pc;
+		unsigned int ref;
+		unsigned int depth; //return addresses found on the runtime stack
+		unsigned int ra[max_depth]; //return addresses, the innermost first
+	};
+
+	//sampling profiler: a timer signal interrupts the thread running a machine in intervals of its CPU time and the
+	//signal handler records the state of the machine into a buffer allocated before, so nothing runs between samples
+	//if the buffer is full, every second sample is dropped and only every second signal is recorded from then on,
+	//so the samples stay spread evenly over long runs
+	class sampler {
+		public:
+			typedef void (*probe)(const void*, sample&); //record the state of a machine, has to be async-signal-safe
+			sampler(probe, const void*, size_t = 1 << 16); //sample the given machine into a buffer of the given size
+			sampler(const sampler&) = delete;
+			sampler& operator=(const sampler&) = delete;
+			~sampler() { stop(); }
+			bool start(unsigned int); //sample the calling thread every given microseconds of its CPU time
+			void stop(void); //no more samples are taken
+			std::vector<sample> samples(void) const; //all samples taken so far, has to be called after stop
+			unsigned long stride(void) const { return every; } //signals per recorded sample
+			//copy "n" cells from "from", which may have been freed meanwhile, returns false if it isn't readable
+			static bool read_cells(const int*, int*, size_t);
+		private:
+			static std::atomic<sampler*> active; //sampler the signal handler records into
+			static void handle(int); //signal handler
+			probe take;
+			const void* machine;
+			std::vector<sample> buffer;
+			size_t count = 0; //samples in the buffer
+			unsigned long every = 1, ticks = 0;
+			timer_t timer;
+			bool armed = false;
+	};
+}
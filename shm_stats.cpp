@@ -0,0 +1,68 @@
+#include <new>
+#include <ctime>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shm_stats.hpp"
+
+namespace am0_interpreter {
+	//current time of the monotonic clock, comparable between processes
+	uint64_t monotonic_ns() {
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+	}
+
+	//unmap the segment, the segment of this process is removed
+	shm_stats_segment::~shm_stats_segment() {
+		if (!stats) return;
+		if (name != "") {
+			stats->running.store(0, std::memory_order_relaxed);
+			shm_unlink(name.c_str());
+		}
+		munmap(stats, sizeof(shm_stats));
+	}
+
+	//create the segment of this process
+	bool shm_stats_segment::create(const std::string& machine, const std::string& program) {
+		std::string n = "/amstat." + std::to_string(getpid());
+		int fd = shm_open(n.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+		if (fd < 0) return false;
+		if (ftruncate(fd, sizeof(shm_stats))) { close(fd); shm_unlink(n.c_str()); return false; }
+		void* p = mmap(nullptr, sizeof(shm_stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (p == MAP_FAILED) { shm_unlink(n.c_str()); return false; }
+		name = n;
+		stats = new (p) shm_stats();
+		stats->pid = getpid();
+		std::strncpy(stats->machine, machine.c_str(), sizeof(stats->machine) - 1);
+		std::strncpy(stats->program, program.c_str(), sizeof(stats->program) - 1);
+		stats->start_ns.store(monotonic_ns(), std::memory_order_relaxed);
+		stats->update_ns.store(monotonic_ns(), std::memory_order_relaxed);
+		stats->running.store(1, std::memory_order_relaxed);
+		//readers ignore the segment until it is initialised completely
+		stats->magic.store(shm_stats::magic_value, std::memory_order_release);
+		return true;
+	}
+
+	//map the segment of another process read only
+	bool shm_stats_segment::open(const std::string& n) {
+		int fd = shm_open(n.c_str(), O_RDONLY, 0);
+		if (fd < 0) return false;
+		void* p = MAP_FAILED;
+		struct stat st;
+		if (!fstat(fd, &st) && (size_t) st.st_size >= sizeof(shm_stats))
+			p = mmap(nullptr, sizeof(shm_stats), PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (p == MAP_FAILED) return false;
+		stats = static_cast<shm_stats*>(p);
+		if (stats->magic.load(std::memory_order_acquire) != shm_stats::magic_value) {
+			munmap(p, sizeof(shm_stats));
+			stats = nullptr;
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,44 @@
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+namespace am0_interpreter {
+	//statistics of a running machine, published in the POSIX shared memory segment "/amstat.<pid>"
+	//every counter is written with relaxed atomics, so readers get a consistent value per counter only
+	struct shm_stats {
+		static const uint32_t magic_value = 0x414d5354; //"AMST"
+		std::atomic<uint32_t> magic; //set last, readers ignore the segment until then
+		int32_t pid;
+		char machine[8]; //"am0" or "am1"
+		char program[112]; //name of the code file
+		std::atomic<uint64_t> start_ns; //time of creation (monotonic clock)
+		std::atomic<uint64_t> update_ns; //time of the last update (monotonic clock)
+		std::atomic<uint64_t> steps; //instructions retired
+		std::atomic<uint64_t> pc; //program counter
+		std::atomic<uint64_t> d_stack; //depth of the data stack
+		std::atomic<uint64_t> rt_stack; //depth of the runtime stack
+		std::atomic<uint64_t> memory; //memory cells in use
+		std::atomic<uint64_t> reads; //values read by READ
+		std::atomic<uint64_t> writes; //values written by WRITE
+		std::atomic<uint32_t> running; //the machine is running
+	};
+
+	static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "statistics are shared between processes and need lock free atomics");
+
+	uint64_t monotonic_ns(void); //current time of the monotonic clock
+
+	//mapping of a statistics segment
+	class shm_stats_segment {
+		public:
+			shm_stats_segment() = default;
+			shm_stats_segment(const shm_stats_segment&) = delete;
+			shm_stats_segment& operator=(const shm_stats_segment&) = delete;
+			~shm_stats_segment(); //unmap the segment, the segment of this process is removed
+			bool create(const std::string&, const std::string&); //create the segment of this process
+			bool open(const std::string&); //map the segment of another process read only
+			shm_stats* get(void) const { return stats; }
+		private:
+			shm_stats* stats = nullptr;
+			std::string name; //name of the created segment, empty if it isn't owned
+	};
+}
@@ -0,0 +1,58 @@
+#include <sstream>
+#include "specializer.hpp"
+
+namespace am0_interpreter {
+	//split a code line into its keyword, the address of a jump, call or spawn and the arguments of SPAWN, e.g. ",2"
+	//returns false if the line doesn't jump
+	static bool jump_target(const std::string& line, std::string& keyword, int& target, std::string& arguments) {
+		std::istringstream ls {line};
+		arguments = "";
+		if (!(ls >> keyword && (keyword == "JMP" || keyword == "JMC" || keyword == "CALL" || keyword == "SPAWN") &&
+			ls >> target)) return false;
+		int n;
+		if (keyword == "SPAWN") {
+			if (ls.get() != ',' || !(ls >> n)) return false;
+			arguments = "," + std::to_string(n);
+		}
+		return true;
+	}
+
+	//write a residual program: the prologue followed by all lines of "code" reachable from "roots"
+	//jump, call and return addresses are relocated to the new line numbers
+	void write_residual(std::ostream& os, const std::vector<residual_line>& prologue,
+		const std::vector<std::string>& code, const std::vector<unsigned int>& roots) {
+		//find all reachable lines, the line after a CALL or SPAWN is reachable by its RET
+		std::vector<bool> reachable(code.size() + 1, false);
+		std::vector<unsigned int> todo;
+		for (auto r : roots) if (r && r <= code.size()) todo.push_back(r);
+		while (!todo.empty()) {
+			unsigned int l = todo.back();
+			todo.pop_back();
+			if (!l || l > code.size() || reachable[l]) continue;
+			reachable[l] = true;
+			std::string keyword, arguments;
+			int target;
+			if (jump_target(code[l - 1], keyword, target, arguments) && target > 0) todo.push_back(target);
+			if (keyword != "JMP" && keyword != "RET") todo.push_back(l + 1);
+		}
+		//new line numbers, the prologue comes first
+		std::vector<int> moved(code.size() + 1, 0);
+		int next = prologue.size();
+		for (size_t l = 1; l <= code.size(); ++l) if (reachable[l]) moved[l] = ++next;
+		auto relocate = [&] (int l) { return (l > 0 && (size_t) l <= code.size()) ? moved[l] : l; };
+		os << "#residual program\n";
+		for (auto& p : prologue) {
+			os << p.text;
+			if (p.code_line >= 0) os << relocate(p.code_line) << ";";
+			os << "\n";
+		}
+		for (size_t l = 1; l <= code.size(); ++l) {
+			if (!reachable[l]) continue;
+			std::string keyword, arguments;
+			int target;
+			if (jump_target(code[l - 1], keyword, target, arguments))
+				os << keyword << " " << relocate(target) << arguments << ";\n";
+			else os << code[l - 1] << "\n";
+		}
+	}
+}
@@ -0,0 +1,17 @@
+#include <string>
+#include <vector>
+#include <ostream>
+
+namespace am0_interpreter {
+	//line of the prologue of a residual program, which rebuilds the state of the machine
+	//if "code_line" isn't negative, the relocated number of this original code line is appended to "text"
+	struct residual_line {
+		std::string text;
+		int code_line;
+	};
+
+	//write a residual program: the prologue followed by all lines of "code" reachable from "roots"
+	//jump, call and return addresses are relocated to the new line numbers
+	void write_residual(std::ostream&, const std::vector<residual_line>&, const std::vector<std::string>&,
+		const std::vector<unsigned int>&);
+}
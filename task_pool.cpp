@@ -0,0 +1,60 @@
+#include <chrono>
+#include "task_pool.hpp"
+
+namespace am1_interpreter {
+	thread_local unsigned int task_pool::worker = 0;
+
+	//start the workers
+	task_pool::task_pool(unsigned int n) {
+		if (!n) n = 1;
+		for (unsigned int i = 0; i < n; ++i) queues.emplace_back(new queue);
+		for (unsigned int i = 1; i < n; ++i) workers.emplace_back([this, i] () {
+			worker = i;
+			unsigned int idle = 0;
+			while (!stopping.load(std::memory_order_relaxed)) {
+				if (run_one()) idle = 0;
+				//back off if there is no work for a while, so a sequential part doesn't compete with spinning workers
+				else if (++idle < 64) std::this_thread::yield();
+				else std::this_thread::sleep_for(std::chrono::microseconds(50));
+			}
+		});
+	}
+
+	//stop the workers, all tasks have to be finished
+	task_pool::~task_pool() {
+		stopping.store(true, std::memory_order_relaxed);
+		for (auto& t : workers) t.join();
+	}
+
+	//queue a task on the queue of the calling worker
+	void task_pool::submit(std::function<void()> f) {
+		queue& q = *queues[worker];
+		std::lock_guard<std::mutex> lock {q.m};
+		q.tasks.push_back(std::move(f));
+	}
+
+	//remove the newest ("own" is true) or the oldest task from queue "i"
+	bool task_pool::take(unsigned int i, bool own, std::function<void()>& f) {
+		queue& q = *queues[i];
+		std::lock_guard<std::mutex> lock {q.m};
+		if (q.tasks.empty()) return false;
+		if (own) {
+			f = std::move(q.tasks.back());
+			q.tasks.pop_back();
+		}
+		else {
+			f = std::move(q.tasks.front());
+			q.tasks.pop_front();
+		}
+		return true;
+	}
+
+	//run a task of the own queue or steal one, returns false if there is none
+	bool task_pool::run_one() {
+		std::function<void()> f;
+		bool found = take(worker, true, f);
+		for (unsigned int i = 1; !found && i < queues.size(); ++i) found = take((worker + i) % queues.size(), false, f);
+		if (found) f();
+		return found;
+	}
+}
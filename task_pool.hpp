@@ -0,0 +1,34 @@
+#include <mutex>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <functional>
+
+namespace am1_interpreter {
+	//pool of worker threads running spawned tasks
+	//every worker owns a queue: it takes its newest task itself, idle workers steal the oldest task of another queue
+	//the thread creating the pool is worker 0 and only runs tasks while it waits for them
+	class task_pool {
+		public:
+			explicit task_pool(unsigned int); //start the workers
+			task_pool(const task_pool&) = delete;
+			task_pool& operator=(const task_pool&) = delete;
+			~task_pool(); //stop the workers, all tasks have to be finished
+			void submit(std::function<void()>); //queue a task on the queue of the calling worker
+			bool run_one(void); //run a task of the own queue or steal one, returns false if there is none
+			std::mutex io; //serialises READ and WRITE of tasks
+		private:
+			struct queue {
+				std::mutex m;
+				std::deque<std::function<void()>> tasks;
+			};
+			std::vector<std::unique_ptr<queue>> queues;
+			std::vector<std::thread> workers;
+			std::atomic<bool> stopping {false};
+			static thread_local unsigned int worker; //index of the calling worker
+
+			bool take(unsigned int, bool, std::function<void()>&); //remove a task from a queue
+	};
+}
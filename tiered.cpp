@@ -0,0 +1,159 @@
+#include <map>
+#include <set>
+#include <climits>
+#include <cstdlib>
+#include <sstream>
+#include "tiered.hpp"
+
+namespace am0_interpreter {
+	namespace {
+		//code line split into its keyword and parameter
+		struct instruction {
+			std::string name;
+			int par = 0;
+			bool local = false; //visibility of an AM1 memory operation
+		};
+
+		instruction decode(const std::string& line) {
+			instruction i;
+			std::istringstream ls {line};
+			std::string text;
+			ls >> std::ws;
+			std::getline(ls, text, ';');
+			size_t paren = text.find('(');
+			if (paren != std::string::npos) {
+				//the indirect operations have no visibility and keep their name, which isn't compiled
+				i.name = text.substr(0, paren);
+				std::string in = text.substr(paren + 1, text.find(')') - paren - 1);
+				size_t comma = in.find(',');
+				if (comma == std::string::npos) i.name += "I";
+				else {
+					i.local = in.substr(0, comma) != "global";
+					i.par = std::atoi(in.substr(comma + 1).c_str());
+				}
+			}
+			else {
+				std::istringstream ps {text};
+				ps >> i.name >> i.par;
+			}
+			return i;
+		}
+
+		const std::map<std::string,micro_op::code> plain = {
+			{"LIT", micro_op::lit}, {"LOAD", micro_op::load}, {"LOADA", micro_op::loada}, {"STORE", micro_op::store},
+			{"ADD", micro_op::add}, {"SUB", micro_op::sub}, {"MUL", micro_op::mul}, {"DIV", micro_op::div},
+			{"MOD", micro_op::mod}, {"LT", micro_op::lt}, {"EQ", micro_op::eq}, {"NE", micro_op::ne},
+			{"GT", micro_op::gt}, {"LE", micro_op::le}, {"GE", micro_op::ge}, {"JMP", micro_op::jmp},
+			{"JMC", micro_op::jmc}
+		};
+
+		bool is_comparison(const std::string& name) {
+			return name == "LT" || name == "EQ" || name == "NE" || name == "GT" || name == "LE" || name == "GE";
+		}
+
+		bool is_jump(micro_op::code c) {
+			return c == micro_op::jmp || c == micro_op::jmc || c == micro_op::branch_lit || c == micro_op::branch_cell;
+		}
+	}
+
+	//compile the loop from the line "header" up to the backward jump at line "end" of the code lines
+	compiled_loop compile_loop(const std::vector<std::string>& code, unsigned int header, unsigned int end) {
+		compiled_loop c;
+		c.header = header;
+		if (!header || header > end || end > code.size()) return c;
+		std::vector<instruction> ins;
+		for (unsigned int l = header; l <= end; ++l) ins.push_back(decode(code[l - 1]));
+		auto at = [&] (unsigned int l) -> const instruction& { return ins[l - header]; };
+		//the jumps the interpreter would reject or which go back to other lines than the header stay interpreted
+		std::set<unsigned int> targets {header};
+		for (unsigned int l = header; l <= end; ++l) {
+			const instruction& i = at(l);
+			if (i.name != "JMP" && i.name != "JMC") continue;
+			if (i.par < 0 || (size_t) i.par > code.size() || (unsigned int) i.par == l) return c;
+			unsigned int t = i.par;
+			if (t > header && t < l) return c;
+			if (t >= header && t <= end) targets.insert(t);
+		}
+		//a global address the interpreter would reject can't be compiled, every other one is checked on entering the loop
+		for (auto& i : ins)
+			if ((i.name == "LOAD" || i.name == "LOADA" || i.name == "STORE") && !i.local && i.par < 0) return c;
+		std::map<std::pair<bool,int>,unsigned int> cells;
+		auto cell = [&] (const instruction& i) {
+			auto key = std::make_pair(i.local, i.par);
+			auto f = cells.find(key);
+			if (f != cells.end()) return f->second;
+			c.cells.push_back(key);
+			return cells[key] = c.cells.size() - 1;
+		};
+		//"n" lines from "l" can be fused if none but the first is jumped to
+		auto fusable = [&] (unsigned int l, unsigned int n) {
+			if (l + n - 1 > end) return false;
+			for (unsigned int k = l + 1; k < l + n; ++k) if (targets.count(k)) return false;
+			return true;
+		};
+		std::map<unsigned int,int> index; //operation of every line an operation starts at
+		for (unsigned int l = header; l <= end; l += c.ops.back().size) {
+			const instruction& i = at(l);
+			auto name = [&] (unsigned int k) -> const std::string& { return at(l + k).name; };
+			micro_op o;
+			o.line = l;
+			//LOAD a; LIT k; ADD or SUB; STORE a
+			if (fusable(l, 4) && i.name == "LOAD" && name(1) == "LIT" && (name(2) == "ADD" || name(2) == "SUB") &&
+				name(3) == "STORE" && at(l + 3).local == i.local && at(l + 3).par == i.par &&
+				(name(2) == "ADD" || at(l + 1).par != INT_MIN)) {
+				o.op = micro_op::add_to_cell;
+				o.cell = cell(i);
+				o.value = (name(2) == "ADD") ? at(l + 1).par : -at(l + 1).par;
+				o.size = 4;
+			}
+			//LOAD a; LIT k or LOAD b; comparison; JMC e
+			else if (fusable(l, 4) && i.name == "LOAD" && (name(1) == "LIT" || name(1) == "LOAD") &&
+				is_comparison(name(2)) && name(3) == "JMC") {
+				o.op = (name(1) == "LIT") ? micro_op::branch_lit : micro_op::branch_cell;
+				o.compare = plain.at(name(2));
+				o.cell = cell(i);
+				if (name(1) == "LIT") o.value = at(l + 1).par;
+				else o.other = cell(at(l + 1));
+				o.target = at(l + 3).par;
+				o.size = 4;
+			}
+			//LIT k; ADD
+			else if (fusable(l, 2) && i.name == "LIT" && name(1) == "ADD") {
+				o.op = micro_op::add_lit;
+				o.value = i.par;
+				o.size = 2;
+			}
+			//LIT k; STORE a
+			else if (fusable(l, 2) && i.name == "LIT" && name(1) == "STORE") {
+				o.op = micro_op::store_lit;
+				o.value = i.par;
+				o.cell = cell(at(l + 1));
+				o.size = 2;
+			}
+			else {
+				auto p = plain.find(i.name);
+				if (p == plain.end()) return c;
+				o.op = p->second;
+				if (o.op == micro_op::load || o.op == micro_op::loada || o.op == micro_op::store) o.cell = cell(i);
+				if (o.op == micro_op::jmp || o.op == micro_op::jmc) o.target = i.par;
+				o.value = i.par;
+				o.local = i.local;
+			}
+			index[l] = c.ops.size();
+			c.ops.push_back(o);
+		}
+		//a loop closed by JMC falls through its last line, which leaves it at the next one
+		if (c.ops.back().op != micro_op::jmp) {
+			micro_op o;
+			o.op = micro_op::jmp;
+			o.line = o.target = end + 1;
+			o.size = 0;
+			c.ops.push_back(o);
+		}
+		for (auto& o : c.ops)
+			if (is_jump(o.op) && o.target >= header && o.target <= end) o.next = index.at(o.target);
+		c.pass = end - header + 1;
+		c.valid = true;
+		return c;
+	}
+}
@@ -0,0 +1,35 @@
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace am0_interpreter {
+	//operation of a compiled loop, fused operations replace the instructions of several lines
+	struct micro_op {
+		enum code {lit, load, loada, store, add, sub, mul, div, mod, lt, eq, ne, gt, le, ge, jmp, jmc,
+			add_lit, add_to_cell, store_lit, branch_lit, branch_cell};
+		code op;
+		code compare = lt; //comparison of branch_lit and branch_cell, they jump if it is false
+		int value = 0; //literal or address of LOADA
+		bool local = false; //LOADA: the address is relative to ref
+		unsigned int cell = 0, other = 0; //memory cells of the loop, "other" is compared by branch_cell
+		unsigned int target = 0; //jump address
+		int next = -1; //operation jumped to, 0 is the header and -1 leaves the loop
+		unsigned int line = 0; //line of the first instruction
+		unsigned int size = 1; //instructions replaced
+	};
+
+	//loop of the code lines from its header up to a backward JMP or JMC to the header, decoded and verified once
+	//every jump leaves the loop, jumps forward in it or back to the header, and no line is jumped into the middle of
+	//a fused operation. The memory cells are resolved every time the loop is entered
+	struct compiled_loop {
+		bool valid = false; //false if the loop can't be compiled, it stays interpreted
+		unsigned int header = 0;
+		unsigned long long pass = 0; //most instructions of one pass through the loop
+		std::vector<micro_op> ops;
+		std::vector<std::pair<bool,int>> cells; //memory cells by their visibility (true if local) and address
+	};
+
+	//compile the loop from the line "header" up to the backward jump at line "end" of the code lines
+	//loops calling procedures, reading, writing, spawning tasks or using the heap or indirect addresses aren't valid
+	compiled_loop compile_loop(const std::vector<std::string>&, unsigned int header, unsigned int end);
+}